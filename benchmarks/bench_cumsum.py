@@ -0,0 +1,71 @@
+"""
+micpy cumsum/cumprod against numpy's serial scan on the host.
+
+A flattened 1-D scan splits the axis between threads, a scan along the
+long axis of a wide 2-D array runs one row per thread, and one along
+its short axis runs lanes side by side.  'with copies' adds sending the
+input and fetching the result, for when the data lives on the host.
+The parallel scans reassociate float sums, so the results are compared
+with a relative tolerance.
+"""
+from __future__ import division, absolute_import, print_function
+
+import numpy as np
+import micpy as mp
+
+from common import best_time, make_parser, device_of, print_row
+
+CASES = [((100000,), None), ((1000000,), None), ((10000000,), None),
+         ((100, 100000), 1), ((100000, 100), 0), ((1000, 1000), 1),
+         ((1000, 1000), 0)]
+FUNCS = ['cumsum', 'cumprod']
+DTYPES = ['float64', 'int64']
+WIDTHS = [8, 8, 13, 5, 9, 12, 9, 8]
+
+
+def operand(name, dtype, shape, rng):
+    if name == 'cumprod':
+        # stay away from overflow: factors close to 1, or 1 and -1
+        if dtype == 'int64':
+            return rng.choice([-1, 1], shape).astype(dtype)
+        return rng.uniform(0.9999, 1.0001, shape).astype(dtype)
+    if dtype == 'int64':
+        return rng.randint(-1000, 1000, shape).astype(dtype)
+    return rng.uniform(-1, 1, shape).astype(dtype)
+
+
+def main():
+    args = make_parser(__doc__).parse_args()
+    device = device_of(args)
+    rng = np.random.RandomState(1234)
+
+    print_row(WIDTHS, ['func', 'dtype', 'shape', 'axis', 'micpy ms',
+                       'with copies', 'numpy ms', 'speedup'])
+    for name in FUNCS:
+        mfunc, nfunc = getattr(mp, name), getattr(np, name)
+        for dtype in DTYPES:
+            for shape, axis in CASES:
+                x = operand(name, dtype, shape, rng)
+                a = mp.to_mic(x, device=device)
+                expected = nfunc(x, axis=axis)
+                if not np.allclose(mp.to_cpu(mfunc(a, axis=axis)),
+                                   expected, rtol=1e-9, atol=1e-9):
+                    raise AssertionError('%s %s %s axis=%s differs'
+                                         % (name, dtype, shape, axis))
+
+                t_mic = best_time(lambda: mfunc(a, axis=axis), args.repeat)
+                t_copies = best_time(
+                    lambda: mp.to_cpu(mfunc(mp.to_mic(x, device=device),
+                                            axis=axis)),
+                    args.repeat)
+                t_np = best_time(lambda: nfunc(x, axis=axis), args.repeat)
+                print_row(WIDTHS, [name, dtype,
+                                   'x'.join(str(d) for d in shape), axis,
+                                   '%.3f' % (t_mic * 1e3),
+                                   '%.3f' % (t_copies * 1e3),
+                                   '%.3f' % (t_np * 1e3),
+                                   '%.2fx' % (t_np / t_mic)])
+
+
+if __name__ == '__main__':
+    main()
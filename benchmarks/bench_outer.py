@@ -0,0 +1,55 @@
+"""
+ufunc.outer: the cache blocked kernel against the broadcasting ufunc
+call it falls back to.
+
+Passing out= makes outer take the broadcasting path, so the second
+column is what every call paid before the blocked kernel.  It writes
+into a preallocated output, which if anything favours it.
+"""
+from __future__ import division, absolute_import, print_function
+
+import numpy as np
+import micpy as mp
+
+from common import best_time, make_parser, device_of, print_row
+
+SHAPES = [(100000, 8), (8, 100000), (1000, 1000), (4000, 4000),
+          (100000, 100)]
+UFUNCS = ['add', 'multiply', 'less']
+DTYPES = ['float32', 'float64', 'int64']
+WIDTHS = [9, 8, 7, 7, 11, 11, 8, 10]
+
+
+def main():
+    args = make_parser(__doc__).parse_args()
+    device = device_of(args)
+
+    print_row(WIDTHS, ['ufunc', 'dtype', 'n', 'm', 'tiled ms',
+                       'bcast ms', 'speedup', 'tiled GB/s'])
+    for name in UFUNCS:
+        ufunc = getattr(mp, name)
+        for dtype in DTYPES:
+            for n, m in SHAPES:
+                a = mp.to_mic((np.random.rand(n) * 100).astype(dtype),
+                              device=device)
+                b = mp.to_mic((np.random.rand(m) * 100).astype(dtype),
+                              device=device)
+                res = ufunc.outer(a, b)
+                out = mp.empty(res.shape, dtype=res.dtype, device=device)
+                ufunc.outer(a, b, out=out)
+                if not np.array_equal(mp.to_cpu(res), mp.to_cpu(out)):
+                    raise AssertionError('%s.outer differs for %s %dx%d'
+                                         % (name, dtype, n, m))
+
+                t_tiled = best_time(lambda: ufunc.outer(a, b), args.repeat)
+                t_bcast = best_time(lambda: ufunc.outer(a, b, out=out),
+                                    args.repeat)
+                print_row(WIDTHS, [name, dtype, n, m,
+                                   '%.3f' % (t_tiled * 1e3),
+                                   '%.3f' % (t_bcast * 1e3),
+                                   '%.2fx' % (t_bcast / t_tiled),
+                                   '%.2f' % (res.nbytes / t_tiled / 1e9)])
+
+
+if __name__ == '__main__':
+    main()
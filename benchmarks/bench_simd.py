@@ -0,0 +1,76 @@
+"""
+Host float loops at each micpy.config.simd_isa level.
+
+Times the AVX2 and AVX-512F kernels of the arithmetic, maximum/minimum,
+comparison and absolute/negative loops against the scalar loops
+('none'), with both operands contiguous and with either one a scalar.
+Every level must give the same result as the scalar loops.
+
+The kernels are only built into the host image, so this runs on the
+host device.  simd_isa is restored afterwards.
+"""
+from __future__ import division, absolute_import, print_function
+
+import numpy as np
+import micpy as mp
+
+from common import (best_time, make_parser, host_device_of, simd_isas,
+                    print_row)
+
+BINARY = ['add', 'subtract', 'multiply', 'divide', 'maximum', 'minimum',
+          'equal', 'not_equal', 'less', 'less_equal', 'greater',
+          'greater_equal']
+UNARY = ['absolute', 'negative']
+DTYPES = ['float32', 'float64']
+SIZES = [1000, 100000, 10000000]
+
+
+def cases(name, dtype, n, device):
+    """(label, call) pairs for one ufunc, dtype and size."""
+    ufunc = getattr(mp, name)
+    a = mp.to_mic((np.random.rand(n) * 200 - 100).astype(dtype),
+                  device=device)
+    if name in UNARY:
+        return [('contig', lambda: ufunc(a))]
+    b = mp.to_mic((np.random.rand(n) * 200 - 100).astype(dtype),
+                  device=device)
+    s = np.dtype(dtype).type(3.5)
+    return [('contig', lambda: ufunc(a, b)),
+            ('scalar1', lambda: ufunc(s, b)),
+            ('scalar2', lambda: ufunc(a, s))]
+
+
+def main():
+    args = make_parser(__doc__).parse_args()
+    device = host_device_of(args)
+    isas = simd_isas()
+    saved = mp.config.simd_isa
+
+    widths = [13, 7, 7, 8] + [10] * len(isas) + [8]
+    print_row(widths, ['ufunc', 'dtype', 'case', 'n'] +
+                      ['%s ms' % isa for isa in isas] + ['speedup'])
+    try:
+        for name in BINARY + UNARY:
+            for dtype in DTYPES:
+                for n in SIZES:
+                    for label, call in cases(name, dtype, n, device):
+                        times, ref = [], None
+                        for isa in isas:
+                            mp.config.simd_isa = isa
+                            res = mp.to_cpu(call())
+                            if ref is None:
+                                ref = res
+                            elif not np.array_equal(res, ref):
+                                raise AssertionError(
+                                    '%s %s %s n=%d differs at %s'
+                                    % (name, dtype, label, n, isa))
+                            times.append(best_time(call, args.repeat))
+                        print_row(widths, [name, dtype, label, n] +
+                                  ['%.3f' % (t * 1e3) for t in times] +
+                                  ['%.2fx' % (times[0] / times[-1])])
+    finally:
+        mp.config.simd_isa = saved
+
+
+if __name__ == '__main__':
+    main()
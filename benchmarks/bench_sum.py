@@ -0,0 +1,95 @@
+"""
+Thread parallel float64 sums against one thread and against numpy.
+
+add.reduce over more than one 65536 element block is split between
+threads.  The same sums are timed on the same device by a child process
+limited to one thread (OMP_NUM_THREADS and MIC_OMP_NUM_THREADS), and
+with numpy on the host.
+Errors are in ULP of the correctly rounded sum (math.fsum).  Sums of
+two or more blocks use a different tree than the serial one, so they
+may differ in the last bits from numpy; the last column says whether
+they don't.
+"""
+from __future__ import division, absolute_import, print_function
+
+import argparse
+import json
+import math
+import os
+import subprocess
+import sys
+
+import numpy as np
+import micpy as mp
+
+from common import best_time, make_parser, device_of, print_row
+
+SIZES = [1000, 65536, 65537, 131072, 1000000, 10000000]
+WIDTHS = [9, 9, 10, 8, 9, 8, 8, 6]
+
+
+def data(n):
+    return np.random.RandomState(n).uniform(-1, 1, n)
+
+
+def time_sums(device, repeat):
+    """n -> (seconds, sum) of add.reduce on `device`."""
+    res = {}
+    for n in SIZES:
+        a = mp.to_mic(data(n), device=device)
+        s = float(mp.to_cpu(mp.add.reduce(a)))
+        res[n] = (best_time(lambda: mp.add.reduce(a), repeat), s)
+    return res
+
+
+def one_thread_sums(args, device):
+    env = dict(os.environ, OMP_NUM_THREADS='1', MIC_ENV_PREFIX='MIC',
+               MIC_OMP_NUM_THREADS='1')
+    out = subprocess.check_output(
+            [sys.executable, os.path.abspath(__file__), '--child',
+             '--device', str(device), '--repeat', str(args.repeat)],
+            env=env)
+    res = json.loads(out.decode().splitlines()[-1])
+    return dict((int(n), tuple(v)) for n, v in res.items())
+
+
+def ulp_error(s, exact):
+    return abs(s - exact) / np.spacing(abs(exact))
+
+
+def main():
+    parser = make_parser(__doc__)
+    parser.add_argument('--child', action='store_true',
+                        help=argparse.SUPPRESS)
+    args = parser.parse_args()
+    device = device_of(args)
+
+    if args.child:
+        print(json.dumps(time_sums(device, args.repeat)))
+        return
+
+    par = time_sums(device, args.repeat)
+    ser = one_thread_sums(args, device)
+
+    print_row(WIDTHS, ['n', 'par ms', '1 thr ms', 'speedup', 'numpy ms',
+                       'par ulp', 'np ulp', '== np'])
+    for n in SIZES:
+        x = data(n)
+        exact = math.fsum(x)
+        t_np = best_time(lambda: x.sum(), args.repeat)
+        s_np = float(x.sum())
+        t_par, s_par = par[n]
+        t_ser, s_ser = ser[n]
+        if s_ser != s_par:
+            raise AssertionError('sum of %d depends on the thread count' % n)
+        print_row(WIDTHS, [n, '%.3f' % (t_par * 1e3),
+                           '%.3f' % (t_ser * 1e3),
+                           '%.2fx' % (t_ser / t_par),
+                           '%.3f' % (t_np * 1e3),
+                           '%.2f' % ulp_error(s_par, exact),
+                           '%.2f' % ulp_error(s_np, exact),
+                           'yes' if s_par == s_np else 'no'])
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,94 @@
+"""
+Accuracy and speed of the host transcendental loops at each
+micpy.config.precision and simd_isa.
+
+For every function and float dtype the same random arguments are run
+at simd_isa 'none' (the scalar loops) and at each vector level the CPU
+accepts, with precision 'accurate' and 'fast'.  The largest error is
+given in ULP of the result against numpy's long double function, the
+time against the scalar loops.  'accurate' uses the scalar math library
+at every level, so its rows show the cost of the dispatch only.
+
+The kernels are only built into the host image, so this runs on the
+host device.  simd_isa and precision are restored afterwards.
+"""
+from __future__ import division, absolute_import, print_function
+
+import numpy as np
+import micpy as mp
+
+from common import (best_time, make_parser, host_device_of, simd_isas,
+                    print_row)
+
+# argument ranges, per dtype where the float32 result would overflow
+RANGES = {
+    'exp': {'float64': (-700, 700), 'float32': (-87, 88)},
+    'expm1': (-5, 5),
+    'log': None,
+    'sin': (-1e4, 1e4),
+    'cos': (-1e4, 1e4),
+    'tanh': (-20, 20),
+    'sqrt': (0, 1e6),
+}
+DTYPES = ['float32', 'float64']
+SIZE = 1000000
+WIDTHS = [6, 8, 8, 9, 8, 9, 8]
+
+
+def arguments(name, dtype, rng):
+    if name == 'log':
+        # every binade of the type
+        info = np.finfo(dtype)
+        e = rng.uniform(np.log2(info.tiny), np.log2(info.max), SIZE)
+        return np.exp2(e).astype(dtype)
+    lo, hi = RANGES[name][dtype] if isinstance(RANGES[name], dict) \
+                                 else RANGES[name]
+    return rng.uniform(lo, hi, SIZE).astype(dtype)
+
+
+def max_ulp(got, ref, dtype):
+    """Largest |got - ref| in ULP of ref rounded to dtype."""
+    rounded = ref.astype(dtype)
+    ok = np.isfinite(rounded) & (rounded != 0)
+    ulp = np.spacing(np.abs(rounded[ok])).astype(np.longdouble)
+    err = np.abs(got[ok].astype(np.longdouble) - ref[ok]) / ulp
+    return float(err.max()) if err.size else 0.0
+
+
+def main():
+    args = make_parser(__doc__).parse_args()
+    device = host_device_of(args)
+    isas = simd_isas()
+    saved = mp.config.simd_isa, mp.config.precision
+    rng = np.random.RandomState(1234)
+
+    print_row(WIDTHS, ['func', 'dtype', 'isa', 'precision', 'max ulp',
+                       'ms', 'speedup'])
+    try:
+        for name in sorted(RANGES):
+            ufunc = getattr(mp, name)
+            for dtype in DTYPES:
+                x = arguments(name, dtype, rng)
+                ref = getattr(np, name)(x.astype(np.longdouble))
+                a = mp.to_mic(x, device=device)
+                t_scalar = None
+                for isa in isas:
+                    for precision in ['accurate', 'fast']:
+                        if isa == 'none' and precision == 'fast':
+                            continue
+                        mp.config.simd_isa = isa
+                        mp.config.precision = precision
+                        ulp = max_ulp(mp.to_cpu(ufunc(a)), ref, dtype)
+                        t = best_time(lambda: ufunc(a), args.repeat)
+                        if t_scalar is None:
+                            t_scalar = t
+                        print_row(WIDTHS, [name, dtype, isa, precision,
+                                           '%.3f' % ulp,
+                                           '%.3f' % (t * 1e3),
+                                           '%.2fx' % (t_scalar / t)])
+    finally:
+        mp.config.simd_isa, mp.config.precision = saved
+
+
+if __name__ == '__main__':
+    main()
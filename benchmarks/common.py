@@ -0,0 +1,75 @@
+"""
+Helpers shared by the micpy benchmark scripts.
+
+The scripts are run directly, e.g. ``python benchmarks/bench_outer.py``,
+and print one table row per case.  Offloaded calls return when the
+device is done, so plain wall clock timing is enough.
+"""
+from __future__ import division, absolute_import, print_function
+
+import argparse
+import timeit
+
+import micpy as mp
+
+
+def best_time(func, repeat=5, min_time=0.2):
+    """
+    Best wall time of one call of `func` in seconds, out of `repeat`
+    runs of as many calls as take at least `min_time` seconds.
+    """
+    timer = timeit.Timer(func)
+    number = 1
+    while True:
+        t = timer.timeit(number)
+        if t >= min_time or number >= 1 << 20:
+            break
+        number *= 2 if t <= 0 else max(2, int(min_time / t * 1.2))
+    return min([t] + timer.repeat(repeat - 1, number)) / number
+
+
+def make_parser(description):
+    parser = argparse.ArgumentParser(description=description)
+    parser.add_argument('--device', type=int, default=None,
+                        help='device to run on, the current one by default')
+    parser.add_argument('--repeat', type=int, default=5,
+                        help='timing runs per case, the best one counts')
+    return parser
+
+
+def device_of(args):
+    return mp.device() if args.device is None else args.device
+
+
+def host_device_of(args):
+    """
+    Device for benchmarks of the host loops: --device, or the current
+    device in host-device mode.  The host id is runtime specific, so it
+    has to be given when there are coprocessors.
+    """
+    if args.device is not None:
+        return args.device
+    if mp.ndevices == 0:
+        return mp.device()
+    raise SystemExit('coprocessors present, pass --device with the id of '
+                     'the host device (omp_get_initial_device())')
+
+
+def simd_isas():
+    """The instruction sets micpy.config.simd_isa accepts here."""
+    saved = mp.config.simd_isa
+    isas = []
+    try:
+        for isa in ['none', 'avx2', 'avx512f']:
+            try:
+                mp.config.simd_isa = isa
+            except ValueError:
+                break
+            isas.append(isa)
+    finally:
+        mp.config.simd_isa = saved
+    return isas
+
+
+def print_row(widths, cells):
+    print('  '.join(str(c).rjust(w) for w, c in zip(widths, cells)))
@@ -12,8 +12,12 @@ else:
     from .multiarray import *
     from .umath import *
     from .numeric import (full, full_like, asarray,
-                          rollaxis, moveaxis, argmax, argmin)
+                          rollaxis, moveaxis, argmax, argmin,
+                          cumsum, cumprod)
     from .shape_base import (expand_dims)
+    from ._config import config
+    from .lazy import lazy, LazyArray
+    from .elementwise import ElementwiseKernel
     from numpy import (int, int_, int8, int16, int32, int64,
                        uint, uint8, uint16, uint32, uint64,
                        float, float_, float16, float32, float64,
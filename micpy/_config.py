@@ -0,0 +1,127 @@
+"""
+Runtime configuration of micpy, available as ``micpy.config``.
+
+Host/device dispatch of small ufunc calls
+-----------------------------------------
+Elementwise ufunc calls on tiny contiguous operands may be run on the
+host instead of offloading them, when a latency/bandwidth model predicts
+that copying the operands back and forth is cheaper than launching a
+target region.  Only loops whose results are bit-identical on both
+sides are considered: integer and boolean loops, and float loops that
+only touch the sign (negative, absolute, copysign, ...).  Float
+arithmetic and comparisons always stay on the device, whose fp model
+flushes denormals and may approximate division and square root.
+
+host_threshold : int
+    Largest total operand size in bytes that may run on the host.
+    Set to 0 to always offload.
+offload_latency, transfer_latency : float
+    Seconds for an empty target region and for a minimal copy.
+link_bandwidth, host_bandwidth, device_bandwidth : float
+    Bytes per second of host <-> device copies, of a loop on the host
+    and of a loop on the device.
+
+Use ``micpy.config.calibrate()`` to measure the model parameters on
+the current machine.
+
+Type resolution cache
+---------------------
+The dtypes and inner loop resolved for a ufunc call are remembered per
+ufunc and combination of operand dtypes, so repeated calls skip numpy's
+type resolution.  ``micpy.config.typecache_info()`` reports how well
+the cache does and ``micpy.config.clear_typecache()`` empties it.
+
+Vector instruction set
+----------------------
+Float arithmetic, comparison, absolute/negative and maximum/minimum
+loops that run on an x86 host use AVX-512F or AVX2 kernels, picked from
+the CPU features at import.
+
+simd_isa : str
+    ``'avx512f'``, ``'avx2'`` or ``'none'``.  It can be lowered, e.g. to
+    compare the kernels, but not raised above what the CPU supports.
+precision : str
+    ``'accurate'`` (default) evaluates exp, expm1, log, sin, cos and tanh
+    with the scalar math library.  ``'fast'`` lets host float loops use
+    vector approximations, within 0.5 ULP for float32 and 2.5 ULP for
+    float64 (see simd.inc.src for the per function bounds).  The
+    coprocessor always uses its own vector math library.
+"""
+from __future__ import division, absolute_import, print_function
+
+from . import umath as _umath
+
+__all__ = ['config']
+
+
+def _dispatch_property(name):
+    def getter(self):
+        return _umath._get_dispatch_config()[name]
+
+    def setter(self, value):
+        _umath._set_dispatch_config(**{name: value})
+
+    return property(getter, setter)
+
+
+class Config(object):
+    """Runtime configuration of micpy, see the module docstring."""
+
+    host_threshold = _dispatch_property('host_threshold')
+    offload_latency = _dispatch_property('offload_latency')
+    transfer_latency = _dispatch_property('transfer_latency')
+    link_bandwidth = _dispatch_property('link_bandwidth')
+    host_bandwidth = _dispatch_property('host_bandwidth')
+    device_bandwidth = _dispatch_property('device_bandwidth')
+
+    @property
+    def simd_isa(self):
+        return _umath._get_simd_isa()['isa']
+
+    @simd_isa.setter
+    def simd_isa(self, value):
+        _umath._set_simd_isa(value)
+
+    @property
+    def precision(self):
+        return _umath._get_precision()
+
+    @precision.setter
+    def precision(self, value):
+        _umath._set_precision(value)
+
+    def calibrate(self, device=None):
+        """
+        Measure the dispatch model parameters on `device` (the current
+        device by default) and make them current.
+
+        Returns
+        -------
+        out : dict
+            The calibrated parameters.
+        """
+        return _umath._calibrate_dispatch(device)
+
+    def typecache_info(self):
+        """
+        Statistics of the type resolution cache.
+
+        Returns
+        -------
+        out : dict
+            ``hits`` and ``misses`` of cacheable calls, their
+            ``hit_rate``, and the number of used ``entries`` out of
+            ``size``.
+        """
+        return _umath._get_typecache_info()
+
+    def clear_typecache(self):
+        """Empty the type resolution cache and reset its statistics."""
+        _umath._clear_typecache()
+
+    def __repr__(self):
+        items = sorted(_umath._get_dispatch_config().items())
+        return 'micpy.config(%s)' % ', '.join('%s=%r' % kv for kv in items)
+
+
+config = Config()
@@ -0,0 +1,283 @@
+"""
+User-defined elementwise kernels compiled at run time.
+
+`ElementwiseKernel` turns a snippet of C into a mufunc.  The snippet is
+placed in a loop with the signature of the generated inner loops of
+micpy.umath, compiled with offload support by the compiler and options
+micpy was built with (micpy.distutils.offloadcompiler) and loaded as a
+shared object.  Compiled objects are cached on disk, keyed by the hash
+of the generated source, the dtype signature and the compiler command
+line, so a kernel is only compiled once per machine.
+
+The address of the loop differs between the host and each device, so
+it is taken on the device itself by a helper compiled along with the
+loop, and a kernel has one mufunc per device it has been run on.
+
+The cache lives in ``$MICPY_KERNEL_CACHE_DIR`` or ``~/.micpy/kernels``.
+Extra compiler flags can be given in ``$MICPY_KERNEL_CFLAGS``.
+"""
+from __future__ import division, absolute_import, print_function
+
+import ctypes
+import hashlib
+import os
+import re
+import shlex
+import shutil
+import tempfile
+
+import numpy
+
+from . import multiarray as _mu
+from . import umath as _umath
+
+__all__ = ['ElementwiseKernel']
+
+_SOURCE_TEMPLATE = """\
+#include <numpy/npy_common.h>
+
+#ifdef __INTEL_OFFLOAD
+#pragma offload_attribute(push, target(mic))
+#endif
+#include <math.h>
+#include <complex.h>
+%(preamble)s
+#ifdef __INTEL_OFFLOAD
+#pragma offload_attribute(pop)
+#define MPY_TARGET_MIC __attribute__((target(mic)))
+#else
+#define MPY_TARGET_MIC
+#endif
+
+MPY_TARGET_MIC void
+%(name)s(char **args, npy_intp *dimensions, npy_intp *steps, void *data)
+{
+    npy_intp i, n = dimensions[0];
+
+#pragma omp parallel for
+    for (i = 0; i < n; ++i) {
+%(loads)s
+%(defines)s
+        %(operation)s;
+%(undefs)s
+    }
+}
+
+/* Address of the loop in the code of 'device', taken on that device */
+npy_intp
+%(name)s_address(int device)
+{
+    npy_intp address = 0;
+
+#pragma omp target device(device) map(from: address)
+    address = (npy_intp)&%(name)s;
+    return address;
+}
+"""
+
+_IDENTIFIER = re.compile(r'^[A-Za-z_][A-Za-z0-9_]*$')
+# Names used by the generated loop itself
+_RESERVED = frozenset(['i', 'n', 'args', 'dimensions', 'steps', 'data'])
+
+# Kernels loaded in this process, by cache key and device
+_loaded = {}
+
+# C99 types of complex parameters, numpy's npy_complex* are structs
+_COMPLEX_CTYPES = {8: 'float _Complex', 16: 'double _Complex',
+                   32: 'long double _Complex'}
+
+
+def _parse_params(params):
+    """'float64 x, int32 y' -> [(dtype('float64'), 'x'), ...]"""
+    result = []
+    for param in params.split(','):
+        words = param.split()
+        if len(words) != 2 or not _IDENTIFIER.match(words[1]):
+            raise ValueError('invalid kernel parameter %r' % param.strip())
+        dtype = numpy.dtype(words[0])
+        # float16 has no C arithmetic type
+        if dtype.kind not in 'biufc' or dtype == numpy.float16:
+            raise TypeError('unsupported kernel dtype %s' % dtype)
+        result.append((dtype, words[1]))
+    return result
+
+
+def _ctype(dtype):
+    if dtype.kind == 'b':
+        return 'npy_bool'
+    if dtype.kind == 'c':
+        return _COMPLEX_CTYPES[dtype.itemsize]
+    prefix = {'i': 'int', 'u': 'uint', 'f': 'float'}
+    return 'npy_%s%d' % (prefix[dtype.kind], dtype.itemsize * 8)
+
+
+def _default_cache_dir():
+    return os.environ.get('MICPY_KERNEL_CACHE_DIR',
+                          os.path.join(os.path.expanduser('~'),
+                                       '.micpy', 'kernels'))
+
+
+def _new_compiler():
+    from distutils.sysconfig import get_python_inc
+    from .distutils.offloadcompiler import IntelOffloadCCompiler
+
+    # The command lines micpy's own offload extensions are built with
+    compiler = IntelOffloadCCompiler()
+    flags = shlex.split(os.environ.get('MICPY_KERNEL_CFLAGS', ''))
+    compiler.add_include_dir(get_python_inc())
+    compiler.add_include_dir(numpy.get_include())
+    return compiler, flags
+
+
+class ElementwiseKernel(object):
+    """
+    ElementwiseKernel(in_params, out_params, operation, name='kernel',
+                      preamble='')
+
+    Elementwise operation defined by a C snippet, run on the device.
+
+    Parameters
+    ----------
+    in_params, out_params : str
+        Comma separated typed parameters, e.g. ``'float64 x, float64 y'``.
+    operation : str
+        C statements computing the outputs for element ``i``.  Inputs
+        are read-only values, outputs are assignable.
+    name : str, optional
+        Name of the kernel and of the compiled loop.
+    preamble : str, optional
+        C code placed before the loop, e.g. helper functions.  It is
+        compiled for both the host and the device.
+
+    Examples
+    --------
+    >>> squared_diff = micpy.ElementwiseKernel(
+    ...     'float64 x, float64 y', 'float64 z', 'z = (x - y) * (x - y)',
+    ...     'squared_diff')
+    >>> z = squared_diff(a, b)
+
+    Calls are forwarded to a mufunc with a single loop, so broadcasting,
+    casting of inputs, ``out=`` and the other ufunc keywords work as for
+    any other micpy ufunc.  The mufunc used is that of the device of the
+    array operands, or of the current device.
+
+    Complex parameters are C99 ``float _Complex`` and ``double _Complex``
+    values, usable with the arithmetic operators and ``<complex.h>``.
+    """
+
+    def __init__(self, in_params, out_params, operation, name='kernel',
+                 preamble=''):
+        if not _IDENTIFIER.match(name):
+            raise ValueError('invalid kernel name %r' % name)
+        self.in_params = _parse_params(in_params)
+        self.out_params = _parse_params(out_params)
+        names = [p[1] for p in self.in_params + self.out_params]
+        if len(set(names)) != len(names) or _RESERVED.intersection(names):
+            raise ValueError('kernel parameter names must be unique and '
+                             'differ from %s' % ', '.join(sorted(_RESERVED)))
+        self.operation = operation
+        self.name = name
+        self.preamble = preamble
+        self._ufuncs = {}
+
+    @property
+    def source(self):
+        """The generated C source of the inner loop."""
+        params = self.in_params + self.out_params
+        nin = len(self.in_params)
+        loads, defines, undefs = [], [], []
+        for k, (dtype, pname) in enumerate(params):
+            ctype = _ctype(dtype)
+            if k < nin:
+                loads.append('        const %s %s = *(%s *)(args[%d] + '
+                             'i * steps[%d]);' % (ctype, pname, ctype, k, k))
+            else:
+                defines.append('#define %s (*(%s *)(args[%d] + '
+                               'i * steps[%d]))' % (pname, ctype, k, k))
+                undefs.append('#undef %s' % pname)
+        return _SOURCE_TEMPLATE % {'preamble': self.preamble,
+                                   'name': self.name,
+                                   'loads': '\n'.join(loads),
+                                   'defines': '\n'.join(defines),
+                                   'operation': self.operation,
+                                   'undefs': '\n'.join(undefs)}
+
+    @property
+    def ufunc(self):
+        """The mufunc running this kernel on the current device."""
+        return self.ufunc_for(_mu.device())
+
+    def ufunc_for(self, device):
+        """The mufunc running this kernel on `device`, built on first use."""
+        if device not in self._ufuncs:
+            self._ufuncs[device] = self._build(device)
+        return self._ufuncs[device]
+
+    def __call__(self, *args, **kwargs):
+        out = kwargs.get('out')
+        if not isinstance(out, tuple):
+            out = (out,)
+        for a in args + out:
+            if isinstance(a, _mu.ndarray):
+                return self.ufunc_for(a.device)(*args, **kwargs)
+        return self.ufunc(*args, **kwargs)
+
+    def _build(self, device):
+        source = self.source
+        compiler, flags = _new_compiler()
+        signature = ''.join(d.char for d, _ in self.in_params) + '->' + \
+            ''.join(d.char for d, _ in self.out_params)
+        key = hashlib.sha1('\0'.join([source, signature,
+                                      ' '.join(compiler.compiler_so),
+                                      ' '.join(flags)])
+                           .encode('utf-8')).hexdigest()
+
+        if (key, device) not in _loaded:
+            path = self._compile(key, source, compiler, flags)
+            # Loading it on the host also loads its device code
+            lib = ctypes.CDLL(path)
+            lookup = getattr(lib, self.name + '_address')
+            lookup.argtypes = [ctypes.c_int]
+            lookup.restype = ctypes.c_ssize_t
+            address = lookup(device)
+            if not address:
+                raise RuntimeError('kernel %s not found on device %d'
+                                   % (self.name, device))
+            types = tuple(d.num for d, _ in self.in_params + self.out_params)
+            _loaded[key, device] = _umath._ufunc_from_kernel(
+                address, types, len(self.in_params), len(self.out_params),
+                self.name, 'Elementwise kernel %s(%s)' % (self.name,
+                                                         signature),
+                lib)
+        return _loaded[key, device]
+
+    def _compile(self, key, source, compiler, flags):
+        cache_dir = _default_cache_dir()
+        path = os.path.join(cache_dir, '%s_%s.so' % (self.name, key))
+        if os.path.exists(path):
+            return path
+
+        if not os.path.isdir(cache_dir):
+            try:
+                os.makedirs(cache_dir)
+            except OSError:
+                # Created concurrently
+                if not os.path.isdir(cache_dir):
+                    raise
+
+        # Build next to the cache so that the final rename is atomic
+        build_dir = tempfile.mkdtemp(prefix='build-', dir=cache_dir)
+        try:
+            src = os.path.join(build_dir, self.name + '.c')
+            with open(src, 'w') as f:
+                f.write(source)
+            objects = compiler.compile([src], output_dir=build_dir,
+                                       extra_postargs=flags)
+            tmp_path = os.path.join(build_dir, os.path.basename(path))
+            compiler.link_shared_object(objects, tmp_path,
+                                        extra_postargs=flags)
+            # Other processes may publish the same kernel concurrently
+            os.rename(tmp_path, path)
+        finally:
+            shutil.rmtree(build_dir, ignore_errors=True)
+        return path
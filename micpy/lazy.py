@@ -0,0 +1,400 @@
+"""
+Lazy evaluation of elementwise expressions.
+
+Inside ``with micpy.lazy():`` elementwise ufunc calls on micpy arrays
+are recorded instead of executed and return `LazyArray` placeholders.
+The expression is evaluated the first time its value is needed, for
+instance when it is printed, indexed, copied to the host or passed to a
+non-elementwise function, or explicitly through ``evaluate()``.
+
+Evaluation fuses all recorded nodes that share the result shape and need
+no casting into a single device kernel which walks the output in chunks
+and keeps intermediate values in cache, so ``a*b + c*d - e`` reads each
+input once and writes only the final result.  Everything else (casting,
+non-trivial broadcasting, ufuncs with keyword arguments) falls back to
+the normal ufunc machinery, with the same results.
+
+Floating point error flags are not reported for fused expressions.
+
+Deferred expressions hold their input arrays by reference, not by value.
+When a ufunc is about to write an array, through ``out=``, an in-place
+operator such as ``a += 1`` or ``ufunc.at``, the pending expressions
+which read that array (or another view of its memory) are evaluated
+first, so ``r = a*b; a += 1`` still gives ``r`` the old ``a*b``.  Writes
+by other means, like `copyto`, `ndarray.fill` or ``to_mic(out=...)``,
+are not tracked: evaluate the expressions reading the destination before
+writing it that way.
+"""
+from __future__ import division, absolute_import, print_function
+
+import numbers
+import weakref
+
+import numpy
+
+from . import multiarray as _mu
+from . import umath as _umath
+
+__all__ = ['lazy', 'LazyArray']
+
+# Must match MPY_LAZY_MAXINSTR in umath/lazy.c
+_MAX_INSTR = 64
+_CONST_ALIGN = 16
+
+_depth = 0
+
+# Nodes not evaluated yet, the write hook is installed while there are any
+_pending = weakref.WeakSet()
+
+
+class lazy(object):
+    """
+    Context manager enabling lazy evaluation of elementwise ufuncs.
+
+    Examples
+    --------
+    >>> with micpy.lazy():
+    ...     r = a*b + c*d - e
+    >>> r.to_cpu()      # evaluated here in one fused kernel
+    """
+
+    def __enter__(self):
+        global _depth
+        _depth += 1
+        _umath._set_lazy(True)
+        return self
+
+    def __exit__(self, *exc_info):
+        global _depth
+        _depth -= 1
+        if _depth == 0:
+            _umath._set_lazy(False)
+        return False
+
+
+class _suspended(object):
+    """Runs ufuncs eagerly even inside a lazy block."""
+
+    def __enter__(self):
+        self._prev = _umath._set_lazy(False)
+        return self
+
+    def __exit__(self, *exc_info):
+        _umath._set_lazy(self._prev)
+        return False
+
+
+def _is_scalar(obj):
+    return isinstance(obj, (numbers.Number, numpy.generic)) and \
+        not isinstance(obj, numpy.ndarray)
+
+
+def _broadcast_shape(shapes):
+    ndim = max(len(s) for s in shapes)
+    result = [1] * ndim
+    for shape in shapes:
+        for i, n in enumerate(shape, ndim - len(shape)):
+            if n != 1:
+                if result[i] not in (1, n):
+                    return None
+                result[i] = n
+    return tuple(result)
+
+
+def _find_loop(ufunc, args, out_dtype):
+    """
+    Loop types numpy's default type resolution picks for `args`, or
+    None if the loop would need casts of array operands.
+    """
+    for types in ufunc.types:
+        ins, out = types.split('->')
+        if 'O' in types or len(ins) != ufunc.nin:
+            continue
+        ins = [numpy.dtype(t) for t in ins]
+        if all(numpy.can_cast(a if _is_scalar(a) else a.dtype, t)
+               for a, t in zip(args, ins)):
+            break
+    else:
+        return None
+
+    if numpy.dtype(out) != out_dtype:
+        return None
+    for a, t in zip(args, ins):
+        if not _is_scalar(a) and a.dtype != t:
+            return None
+    return ins + [numpy.dtype(out)]
+
+
+class LazyArray(object):
+    """
+    Placeholder for the result of a deferred elementwise ufunc call.
+
+    `shape`, `dtype` and `device` are known without evaluating, any
+    other use evaluates the expression and forwards to the result.
+    """
+
+    # Makes ndarray binary operators defer to the reflected methods
+    __array_priority__ = 1000.0
+    __hash__ = None
+
+    def __init__(self, ufunc, args, shape, dtype, device, loop):
+        self._ufunc = ufunc
+        self._args = args
+        self._loop = loop
+        self._value = None
+        self.shape = shape
+        self.dtype = dtype
+        self.device = device
+
+    @property
+    def ndim(self):
+        return len(self.shape)
+
+    @property
+    def size(self):
+        return int(numpy.prod(self.shape, dtype=numpy.intp))
+
+    def evaluate(self):
+        """Evaluate the expression and return the resulting array."""
+        if self._value is None:
+            self._value = _evaluate(self)
+            # Drop the graph, inputs may be freed now
+            self._ufunc = self._args = self._loop = None
+            _pending.discard(self)
+            if not _pending:
+                _umath._set_lazy_write_hook(None)
+        return self._value
+
+    def __getattr__(self, name):
+        return getattr(self.evaluate(), name)
+
+    def __getitem__(self, key):
+        return self.evaluate()[key]
+
+    def __setitem__(self, key, value):
+        self.evaluate()[key] = value
+
+    def __len__(self):
+        return len(self.evaluate())
+
+    def __iter__(self):
+        return iter(self.evaluate())
+
+    def __repr__(self):
+        return repr(self.evaluate())
+
+    def __str__(self):
+        return str(self.evaluate())
+
+    def __bool__(self):
+        return bool(self.evaluate())
+
+    __nonzero__ = __bool__
+
+    def __int__(self):
+        return int(self.evaluate())
+
+    def __float__(self):
+        return float(self.evaluate())
+
+    def __complex__(self):
+        return complex(self.evaluate())
+
+
+def _binary(name):
+    def op(self, other):
+        return getattr(_umath, name)(self, other)
+
+    def rop(self, other):
+        return getattr(_umath, name)(other, self)
+    return op, rop
+
+
+def _unary(name):
+    def op(self):
+        return getattr(_umath, name)(self)
+    return op
+
+
+for _op, _ufunc in [('add', 'add'), ('sub', 'subtract'),
+                    ('mul', 'multiply'), ('truediv', 'true_divide'),
+                    ('div', 'divide'), ('floordiv', 'floor_divide'),
+                    ('mod', 'remainder'), ('pow', 'power'),
+                    ('and', 'bitwise_and'), ('or', 'bitwise_or'),
+                    ('xor', 'bitwise_xor'), ('lshift', 'left_shift'),
+                    ('rshift', 'right_shift')]:
+    if hasattr(_umath, _ufunc):
+        _f, _rf = _binary(_ufunc)
+        setattr(LazyArray, '__%s__' % _op, _f)
+        setattr(LazyArray, '__r%s__' % _op, _rf)
+
+for _op, _ufunc in [('lt', 'less'), ('le', 'less_equal'),
+                    ('gt', 'greater'), ('ge', 'greater_equal'),
+                    ('eq', 'equal'), ('ne', 'not_equal')]:
+    setattr(LazyArray, '__%s__' % _op, _binary(_ufunc)[0])
+
+for _op, _ufunc in [('neg', 'negative'), ('pos', 'positive'),
+                    ('abs', 'absolute'), ('invert', 'invert')]:
+    if hasattr(_umath, _ufunc):
+        setattr(LazyArray, '__%s__' % _op, _unary(_ufunc))
+
+
+def _concrete(obj):
+    return obj.evaluate() if isinstance(obj, LazyArray) else obj
+
+
+def _defer(ufunc, args):
+    """Records the call, or returns None if it has to run eagerly."""
+    if ufunc.nout != 1 or ufunc.signature is not None or \
+            len(args) != ufunc.nin:
+        return None
+    np_ufunc = getattr(numpy, ufunc.__name__, None)
+    if not isinstance(np_ufunc, numpy.ufunc):
+        return None
+
+    shapes, devices, proxies = [], set(), []
+    for a in args:
+        if isinstance(a, (LazyArray, _mu.ndarray)):
+            if not a.shape:
+                # 0-d operands take part in value based casting
+                return None
+            shapes.append(tuple(a.shape))
+            devices.add(a.device)
+            # Empty stand-ins give the result dtype without any work
+            proxies.append(numpy.empty((0,), dtype=a.dtype))
+        elif _is_scalar(a):
+            proxies.append(a)
+        else:
+            return None
+    if not shapes or len(devices) != 1:
+        return None
+    shape = _broadcast_shape(shapes)
+    if shape is None:
+        return None
+
+    with numpy.errstate(all='ignore'):
+        dtype = np_ufunc(*proxies).dtype
+    node = LazyArray(ufunc, tuple(args), shape, dtype, devices.pop(),
+                     _find_loop(ufunc, args, dtype))
+    if not _pending:
+        _umath._set_lazy_write_hook(_written)
+    _pending.add(node)
+    return node
+
+
+def _memory_root(arr):
+    """The array owning the memory `arr` is a view of."""
+    while isinstance(arr.base, (_mu.ndarray, numpy.ndarray)):
+        arr = arr.base
+    return arr
+
+
+def _written(arr):
+    """Write hook, evaluates the pending nodes reading `arr`."""
+    root = _memory_root(arr)
+    for node in list(_pending):
+        if node._value is None and \
+                any(isinstance(a, _mu.ndarray) and _memory_root(a) is root
+                    for a in node._args):
+            node.evaluate()
+
+
+def _hook(ufunc, args, kwds):
+    if _depth > 0 and not kwds:
+        node = _defer(ufunc, args)
+        if node is not None:
+            return node
+    return tuple(_concrete(a) for a in args)
+
+
+def _eager(node):
+    args = [_concrete(a) for a in node._args]
+    with _suspended():
+        return node._ufunc(*args)
+
+
+class _Program(object):
+    """Linearizes a fusable subgraph for _lazy_execute."""
+
+    def __init__(self, size):
+        self.size = size
+        self.leaves = []
+        self.consts = bytearray()
+        self.const_offsets = []
+        self.instrs = []
+        self.temps = {}
+        # Nodes being added whose instruction is still to come
+        self.pending = 0
+
+    def _leaf(self, arr):
+        for i, leaf in enumerate(self.leaves):
+            if leaf is arr:
+                return ('leaf', i)
+        self.leaves.append(arr)
+        return ('leaf', len(self.leaves) - 1)
+
+    def _const(self, value, dtype):
+        pad = -len(self.consts) % _CONST_ALIGN
+        self.consts.extend(b'\0' * pad)
+        self.const_offsets.append(len(self.consts))
+        self.consts.extend(numpy.array(value, dtype=dtype).tobytes())
+        return ('const', len(self.const_offsets) - 1)
+
+    def _fits(self, arr):
+        return arr.flags.c_contiguous and arr.size in (self.size, 1)
+
+    def fusable(self, node):
+        if node._loop is None or \
+                len(self.instrs) + self.pending >= _MAX_INSTR:
+            return False
+        for a in node._args:
+            if isinstance(a, LazyArray) and a._value is None:
+                # Evaluated separately if it can't be fused
+                if a.size not in (self.size, 1):
+                    return False
+            elif not _is_scalar(a) and not self._fits(_concrete(a)):
+                return False
+        return True
+
+    def add(self, node):
+        if id(node) in self.temps:
+            return ('temp', self.temps[id(node)])
+        self.pending += 1
+        refs = []
+        for a, t in zip(node._args, node._loop):
+            if isinstance(a, LazyArray) and a._value is None:
+                if a.size == self.size and self.fusable(a):
+                    refs.append(self.add(a))
+                    continue
+                a = a.evaluate()
+            if _is_scalar(a):
+                refs.append(self._const(a, t))
+            else:
+                refs.append(self._leaf(a))
+        self.pending -= 1
+        self.instrs.append((node._ufunc,
+                            tuple(t.num for t in node._loop), refs))
+        self.temps[id(node)] = len(self.instrs) - 1
+        return ('temp', len(self.instrs) - 1)
+
+    def execute(self, out):
+        base = {'leaf': 0, 'const': len(self.leaves),
+                'temp': len(self.leaves) + len(self.const_offsets)}
+        program = tuple((ufunc, types,
+                         tuple(base[kind] + i for kind, i in refs))
+                        for ufunc, types, refs in self.instrs)
+        _umath._lazy_execute(out, tuple(self.leaves), bytes(self.consts),
+                             tuple(self.const_offsets), program)
+
+
+def _evaluate(node):
+    program = _Program(node.size)
+    if not program.fusable(node):
+        return _eager(node)
+    program.add(node)
+    out = _mu.empty(node.shape, dtype=node.dtype, device=node.device)
+    program.execute(out)
+    return out
+
+
+_umath._set_lazy_hook(_hook, LazyArray)
@@ -13,9 +13,9 @@
 #define _MICARRAYMODULE
 #include "common.h"
 #include "alloc.h"
+#include "mempool.h"
 #include <assert.h>
 
-#define NBUCKETS 1024 /* number of buckets for data*/
 #define NBUCKETS_DIM 16 /* number of buckets for dimensions/strides */
 #define NCACHE 7 /* number of cache entries per bucket */
 /* this structure fits neatly into a cacheline */
@@ -23,37 +23,18 @@ typedef struct {
     npy_uintp available; /* number of cached pointers */
     void * ptrs[NCACHE];
 } cache_bucket;
-static cache_bucket datacache[NMAXDEVICES*NBUCKETS];
 static cache_bucket dimcache[NBUCKETS_DIM];
 
 /*
  * very simplistic small memory block cache to avoid more expensive libc
  * allocations
- * base function for data cache with 1 byte buckets and dimension cache with
- * sizeof(npy_intp) byte buckets
+ * base function for dimension cache with sizeof(npy_intp) byte buckets
  */
-static NPY_INLINE void *
-_mpy_alloc_cache(int dev, npy_uintp nelem, npy_uintp esz, npy_uint msz,
-                 cache_bucket * cache, void * (*alloc)(size_t, int))
-{
-    assert((dev >= 0 && dev < NDEVICES) &&
-           ((esz == 1 && cache == datacache) ||
-            (esz == sizeof(npy_intp) && cache == dimcache)));
-    if (nelem < msz) {
-        int i = dev*msz + nelem;
-        if (cache[i].available > 0) {
-            return cache[i].ptrs[--(cache[i].available)];
-        }
-    }
-    return alloc(nelem * esz, dev);
-}
-
 static NPY_INLINE void *
 _npy_alloc_cache(npy_uintp nelem, npy_uintp esz, npy_uint msz,
                  cache_bucket * cache, void * (*alloc)(size_t))
 {
-    assert((esz == 1 && cache == datacache) ||
-           (esz == sizeof(npy_intp) && cache == dimcache));
+    assert(esz == sizeof(npy_intp) && cache == dimcache);
     if (nelem < msz) {
         if (cache[nelem].available > 0) {
             return cache[nelem].ptrs[--(cache[nelem].available)];
@@ -64,23 +45,9 @@ _npy_alloc_cache(npy_uintp nelem, npy_uintp esz, npy_uint msz,
 
 /*
  * return pointer p to cache, nelem is number of elements of the cache bucket
- * size (1 or sizeof(npy_intp)) of the block pointed too
+ * size (sizeof(npy_intp)) of the block pointed too
  */
 static NPY_INLINE void
-_mpy_free_cache(int dev, void * p, npy_uintp nelem, npy_uint msz,
-                cache_bucket * cache, void (*dealloc)(void *, int))
-{
-    assert(dev >= 0 && dev < NDEVICES);
-    if (p != NULL && nelem < msz) {
-        int i = dev*msz + nelem;
-        if (cache[i].available < NCACHE) {
-            cache[i].ptrs[cache[i].available++] = p;
-            return;
-        }
-    }
-    dealloc(p, dev);
-}
-static NPY_INLINE void
 _npy_free_cache(void * p, npy_uintp nelem, npy_uint msz,
                 cache_bucket * cache, void (*dealloc)(void *))
 {
@@ -95,36 +62,40 @@ _npy_free_cache(void * p, npy_uintp nelem, npy_uint msz,
 
 /*
  * array data cache, sz is number of bytes to allocate
+ * device blocks of every size are recycled by the device memory pool
  */
 NPY_NO_EXPORT void *
 mpy_alloc_cache(npy_uintp sz, int device)
 {
-    return _mpy_alloc_cache(device, sz, 1, NBUCKETS, datacache, &PyDataMemMic_NEW);
+    return mpy_pool_malloc(sz, device);
 }
 
 /* zero initialized data, sz is number of bytes to allocate */
 NPY_NO_EXPORT void *
 mpy_alloc_cache_zero(npy_uintp sz, int device)
 {
-    void * p;
-    if (sz < NBUCKETS) {
-        p = _mpy_alloc_cache(device, sz, 1, NBUCKETS, datacache, &PyDataMemMic_NEW);
-        if (p) {
-            #pragma omp target device(device) map(to:p,sz)
-            memset(p, 0, sz);
-        }
-        return p;
+    void * p = mpy_pool_malloc(sz, device);
+    if (p && sz > 0) {
+        Py_BEGIN_ALLOW_THREADS
+        target_memset(p, 0, sz, device);
+        Py_END_ALLOW_THREADS
     }
-    Py_BEGIN_ALLOW_THREADS
-    p = PyDataMemMic_NEW_ZEROED(sz, 1, device);
-    Py_END_ALLOW_THREADS
     return p;
 }
 
+/*
+ * resize array data, the first min(old, new) bytes are kept
+ */
+NPY_NO_EXPORT void *
+mpy_realloc_cache(void * p, npy_uintp sz, int device)
+{
+    return mpy_pool_realloc(p, sz, device);
+}
+
 NPY_NO_EXPORT void
-mpy_free_cache(void * p, npy_uintp sz, int device)
+mpy_free_cache(void * p, npy_uintp NPY_UNUSED(sz), int device)
 {
-    _mpy_free_cache(device, p, sz, NBUCKETS, datacache, &PyDataMemMic_FREE);
+    mpy_pool_free(p, device);
 }
 
 /*
@@ -9,6 +9,9 @@ mpy_alloc_cache(npy_uintp sz, int device);
 NPY_NO_EXPORT void *
 mpy_alloc_cache_zero(npy_uintp sz, int device);
 
+NPY_NO_EXPORT void *
+mpy_realloc_cache(void * p, npy_uintp sz, int device);
+
 NPY_NO_EXPORT void
 mpy_free_cache(void * p, npy_uintp sd, int device);
 
@@ -19,6 +19,8 @@
 #include "dtype_transfer.h"
 #include "common.h"
 #include "shape.h"
+#include "alloc.h"
+#include "mempool.h"
 
 #include "array_assign.h"
 
@@ -588,24 +590,274 @@ raw_array_wheremasked_assign_array(int ndim, npy_intp *shape,
 }
 
 /*
- * Assigns the array from 'src'(host) to 'dst'(device). The strides must already have
- * been broadcast.
+ * Copies a strided block between two buffers on the same device, one row
+ * of shape[0] items per iteration with the rows spread over the threads.
+ * It runs on the host or inside a target region, and is used to pack
+ * strided data into a contiguous staging buffer and to scatter it back.
+ */
+static MPY_TARGET_MIC void
+raw_array_strided_copy(int ndim, npy_intp *shape, npy_intp itemsize,
+        int aligned,
+        char *dst_data, npy_intp *dst_strides,
+        char *src_data, npy_intp *src_strides)
+{
+    npy_intp nrows = 1, row;
+    int idim;
+
+    for (idim = 1; idim < ndim; ++idim) {
+        nrows *= shape[idim];
+    }
+
+    #pragma omp parallel for
+    for (row = 0; row < nrows; ++row) {
+        npy_intp i, n = shape[0], rem = row;
+        npy_intp dst_stride = dst_strides[0], src_stride = src_strides[0];
+        char *dst = dst_data, *src = src_data;
+        int k;
+
+        for (k = 1; k < ndim; ++k) {
+            npy_intp coord = rem % shape[k];
+            rem /= shape[k];
+            dst += coord * dst_strides[k];
+            src += coord * src_strides[k];
+        }
+
+        if (!aligned) {
+            for (i = 0; i < n; ++i) {
+                memmove(dst + i*dst_stride, src + i*src_stride, itemsize);
+            }
+            continue;
+        }
+
+        switch (itemsize) {
+            case 1:
+                for (i = 0; i < n; ++i) {
+                    *(npy_uint8 *)(dst + i*dst_stride) =
+                                    *(npy_uint8 *)(src + i*src_stride);
+                }
+                break;
+            case 2:
+                for (i = 0; i < n; ++i) {
+                    *(npy_uint16 *)(dst + i*dst_stride) =
+                                    *(npy_uint16 *)(src + i*src_stride);
+                }
+                break;
+            case 4:
+                for (i = 0; i < n; ++i) {
+                    *(npy_uint32 *)(dst + i*dst_stride) =
+                                    *(npy_uint32 *)(src + i*src_stride);
+                }
+                break;
+            case 8:
+                for (i = 0; i < n; ++i) {
+                    *(npy_uint64 *)(dst + i*dst_stride) =
+                                    *(npy_uint64 *)(src + i*src_stride);
+                }
+                break;
+            case 16:
+                for (i = 0; i < n; ++i) {
+                    *(npy_uint64 *)(dst + i*dst_stride) =
+                                    *(npy_uint64 *)(src + i*src_stride);
+                    *((npy_uint64 *)(dst + i*dst_stride) + 1) =
+                                    *((npy_uint64 *)(src + i*src_stride) + 1);
+                }
+                break;
+            default:
+                for (i = 0; i < n; ++i) {
+                    memcpy(dst + i*dst_stride, src + i*src_stride, itemsize);
+                }
+                break;
+        }
+    }
+}
+
+/*
+ * Runs raw_array_strided_copy on 'device', offloading it when the
+ * device is not the host.
+ */
+static void
+raw_array_strided_copy_on(int device, int ndim, npy_intp *shape,
+        npy_intp itemsize, int aligned,
+        char *dst_data, npy_intp *dst_strides,
+        char *src_data, npy_intp *src_strides)
+{
+    if (device == omp_get_initial_device()) {
+        raw_array_strided_copy(ndim, shape, itemsize, aligned,
+                               dst_data, dst_strides,
+                               src_data, src_strides);
+        return;
+    }
+
+    #pragma omp target device(device) map(to: ndim, itemsize, aligned, \
+                                              shape[0:ndim], \
+                                              dst_data, dst_strides[0:ndim], \
+                                              src_data, src_strides[0:ndim])
+    raw_array_strided_copy(ndim, shape, itemsize, aligned,
+                           dst_data, dst_strides,
+                           src_data, src_strides);
+}
+
+/*
+ * Returns 1 if 'strides' walk the block exactly like 'contig_strides',
+ * ignoring dimensions of length one.
+ */
+static int
+raw_array_strides_match(int ndim, npy_intp *shape,
+        npy_intp *strides, npy_intp *contig_strides)
+{
+    int idim;
+
+    for (idim = 0; idim < ndim; ++idim) {
+        if (shape[idim] != 1 && strides[idim] != contig_strides[idim]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Casts a host block described by raw strides, through temporary numpy
+ * views so the numpy casting loops are used.
+ */
+static int
+raw_array_cast_on_host(int ndim, npy_intp *shape,
+        PyArray_Descr *dst_dtype, char *dst_data, npy_intp *dst_strides,
+        PyArray_Descr *src_dtype, char *src_data, npy_intp *src_strides)
+{
+    PyArrayObject *dst, *src;
+    int ret;
+
+    Py_INCREF(dst_dtype);
+    dst = (PyArrayObject *)PyArray_NewFromDescr(&PyArray_Type, dst_dtype,
+                            ndim, shape, dst_strides, dst_data,
+                            NPY_ARRAY_WRITEABLE, NULL);
+    if (dst == NULL) {
+        return -1;
+    }
+    Py_INCREF(src_dtype);
+    src = (PyArrayObject *)PyArray_NewFromDescr(&PyArray_Type, src_dtype,
+                            ndim, shape, src_strides, src_data,
+                            0, NULL);
+    if (src == NULL) {
+        Py_DECREF(dst);
+        return -1;
+    }
+
+    ret = PyArray_CopyInto(dst, src);
+
+    Py_DECREF(dst);
+    Py_DECREF(src);
+    return ret;
+}
+
+/*
+ * Device to device copies go through a pipeline of two host buffers of
+ * MPY_PEER_CHUNK bytes, unless the offload runtime is known to copy
+ * between devices directly (build with MPY_DEVICE_PEER_COPY defined).
+ */
+#define MPY_PEER_CHUNK ((npy_intp)4 << 20)
+
+/* Bytes and seconds of the last device to device copy */
+static npy_intp peer_copy_bytes = 0;
+static double peer_copy_seconds = 0.0;
+
+NPY_NO_EXPORT void
+mpy_get_peer_copy_stats(npy_intp *nbytes, double *seconds)
+{
+    *nbytes = peer_copy_bytes;
+    *seconds = peer_copy_seconds;
+}
+
+/*
+ * Copies 'nbytes' from 'src_device' to 'dst_device' through the two host
+ * buffers of 'chunk' bytes at 'pipe'.  While one chunk is uploaded the
+ * next one is downloaded into the other buffer.  Runs without the GIL.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+static int
+raw_device_pipeline_copy(char *dst, int dst_device,
+        char *src, int src_device, npy_intp nbytes,
+        char *pipe, npy_intp chunk)
+{
+    npy_intp nchunks = (nbytes + chunk - 1) / chunk;
+    int host_device = omp_get_initial_device();
+    int failed = 0;
+
+    #pragma omp parallel num_threads(2)
+    {
+        int tid = omp_get_thread_num();
+        int nthreads = omp_get_num_threads();
+        npy_intp step, offset, len;
+
+        for (step = 0; step <= nchunks; ++step) {
+            /* Download chunk 'step' */
+            if (tid == 0 && step < nchunks) {
+                offset = step * chunk;
+                len = (nbytes - offset < chunk) ? nbytes - offset : chunk;
+                if (omp_target_memcpy(pipe + (step & 1) * chunk,
+                                      src + offset, len, 0, 0,
+                                      host_device, src_device) != 0) {
+                    #pragma omp atomic write
+                    failed = 1;
+                }
+            }
+            /* Upload chunk 'step - 1' */
+            if ((tid == 1 || nthreads == 1) && step > 0) {
+                offset = (step - 1) * chunk;
+                len = (nbytes - offset < chunk) ? nbytes - offset : chunk;
+                if (omp_target_memcpy(dst + offset,
+                                      pipe + ((step - 1) & 1) * chunk,
+                                      len, 0, 0,
+                                      dst_device, host_device) != 0) {
+                    #pragma omp atomic write
+                    failed = 1;
+                }
+            }
+            #pragma omp barrier
+        }
+    }
+
+    return failed ? -1 : 0;
+}
+
+/*
+ * Assigns the array from 'src' on 'src_device' to 'dst' on 'dst_device'.
+ * The strides must already have been broadcast.
+ *
+ * Data always crosses the link in a single omp_target_memcpy. A strided
+ * source is first packed into a contiguous staging buffer on its own
+ * device, and a strided destination is filled by scattering a contiguous
+ * staging buffer on its device, both with a parallel copy kernel.  Host
+ * staging buffers come from the pinned host pool.
+ *
+ * If the dtypes differ, the items cross the link as 'src_dtype' and the
+ * cast is done while scattering the staging buffer into 'dst'.
  *
  * Returns 0 on success, -1 on failure.
  */
 NPY_NO_EXPORT int
 raw_array_assign_device_array(int ndim, npy_intp *shape,
-        PyArray_Descr *dtype,
+        PyArray_Descr *dst_dtype,
         int dst_device, char *dst_data, npy_intp *dst_strides,
+        PyArray_Descr *src_dtype,
         int src_device, char *src_data, npy_intp *src_strides)
 {
-    int idim;
+    int idim, aligned, ret = 0;
     npy_intp shape_it[NPY_MAXDIMS];
     npy_intp dst_strides_it[NPY_MAXDIMS];
     npy_intp src_strides_it[NPY_MAXDIMS];
-    npy_intp coord[NPY_MAXDIMS];
-
-    npy_intp itemsize = dtype->elsize;
+    npy_intp contig_strides[NPY_MAXDIMS];
+    npy_intp nbytes;
+    char *dst_stage, *src_stage;
+    char *pipe = NULL;
+    npy_intp chunk = 0;
+    double start_time = 0.0;
+    int dst_contig, src_contig, peer;
+
+    npy_intp itemsize = src_dtype->elsize;
+    int cast = !PyArray_EquivTypes(dst_dtype, src_dtype);
+    int host_device = omp_get_initial_device();
 
     NPY_BEGIN_THREADS_DEF;
 
@@ -620,26 +872,149 @@ raw_array_assign_device_array(int ndim, npy_intp *shape,
         return -1;
     }
 
-    /* Get Host device number */
-    int host_device = omp_get_initial_device();
-
-    NPY_BEGIN_THREADS;
+    /* Layout of the staging buffers, C order in iteration order */
+    nbytes = itemsize;
+    for (idim = 0; idim < ndim; ++idim) {
+        contig_strides[idim] = nbytes;
+        nbytes *= shape_it[idim];
+    }
+    if (nbytes == 0) {
+        return 0;
+    }
 
-    NPY_RAW_ITER_START(idim, ndim, coord, shape_it) {
-        /* Process the innermost dimension */
-        if (omp_target_memcpy(dst_data, src_data,
-                            itemsize * shape_it[0],
-                            0, 0,
-                            dst_device, src_device) < 0) {
+    dst_contig = !cast && raw_array_strides_match(ndim, shape_it,
+                                         dst_strides_it, contig_strides);
+    src_contig = raw_array_strides_match(ndim, shape_it,
+                                         src_strides_it, contig_strides);
+    aligned = raw_array_is_aligned(ndim, dst_data, dst_strides_it,
+                                   dst_dtype->alignment) &&
+              raw_array_is_aligned(ndim, src_data, src_strides_it,
+                                   src_dtype->alignment);
+
+    /* Staging buffers are allocated with the GIL held */
+    dst_stage = dst_data;
+    src_stage = src_data;
+    if (!dst_contig) {
+        dst_stage = (dst_device == host_device) ?
+                            mpy_host_pool_malloc(nbytes) :
+                            mpy_alloc_cache(nbytes, dst_device);
+        if (dst_stage == NULL) {
+            PyErr_NoMemory();
             return -1;
         }
-    } NPY_RAW_ITER_TWO_NEXT(idim, ndim, coord, shape_it,
-                            dst_data, dst_strides_it,
-                            src_data, src_strides_it);
+    }
+    if (!src_contig) {
+        src_stage = (src_device == host_device) ?
+                            mpy_host_pool_malloc(nbytes) :
+                            mpy_alloc_cache(nbytes, src_device);
+        if (src_stage == NULL) {
+            PyErr_NoMemory();
+            ret = -1;
+            goto finish;
+        }
+    }
+
+    peer = (src_device != host_device && dst_device != host_device &&
+            src_device != dst_device);
+#ifndef MPY_DEVICE_PEER_COPY
+    if (peer) {
+        chunk = (nbytes < MPY_PEER_CHUNK) ? nbytes : MPY_PEER_CHUNK;
+        pipe = mpy_host_pool_malloc(2 * chunk);
+        if (pipe == NULL) {
+            PyErr_NoMemory();
+            ret = -1;
+            goto finish;
+        }
+    }
+#endif
+
+    NPY_BEGIN_THREADS;
+
+    if (!src_contig) {
+        raw_array_strided_copy_on(src_device, ndim, shape_it, itemsize,
+                                  aligned,
+                                  src_stage, contig_strides,
+                                  src_data, src_strides_it);
+    }
+
+    if (peer) {
+        start_time = omp_get_wtime();
+    }
+    if (pipe != NULL) {
+        ret = raw_device_pipeline_copy(dst_stage, dst_device,
+                                       src_stage, src_device, nbytes,
+                                       pipe, chunk);
+    }
+    else if (omp_target_memcpy(dst_stage, src_stage, nbytes, 0, 0,
+                               dst_device, src_device) != 0) {
+        ret = -1;
+    }
+
+    if (ret == 0 && !dst_contig && !cast) {
+        raw_array_strided_copy_on(dst_device, ndim, shape_it, itemsize,
+                                  aligned,
+                                  dst_data, dst_strides_it,
+                                  dst_stage, contig_strides);
+    }
 
     NPY_END_THREADS;
 
-    return (PyErr_Occurred()) ? -1 : 0;
+    if (peer && ret == 0) {
+        peer_copy_bytes = nbytes;
+        peer_copy_seconds = omp_get_wtime() - start_time;
+    }
+
+    if (ret < 0) {
+        PyErr_SetString(PyExc_RuntimeError,
+                        "failed to transfer array data between devices");
+    }
+    else if (cast) {
+        /* Cast and scatter in one pass over the staging buffer */
+        if (dst_device == host_device) {
+            ret = raw_array_cast_on_host(ndim, shape_it,
+                                dst_dtype, dst_data, dst_strides_it,
+                                src_dtype, dst_stage, contig_strides);
+        }
+        else {
+            ret = raw_array_assign_array(dst_device, ndim, shape_it,
+                                dst_dtype, dst_data, dst_strides_it,
+                                src_dtype, dst_stage, contig_strides);
+        }
+    }
+
+finish:
+    if (pipe != NULL) {
+        mpy_host_pool_free(pipe, 2 * chunk);
+    }
+    if (!src_contig && src_stage != NULL) {
+        if (src_device == host_device) {
+            mpy_host_pool_free(src_stage, nbytes);
+        }
+        else {
+            mpy_free_cache(src_stage, nbytes, src_device);
+        }
+    }
+    if (!dst_contig) {
+        if (dst_device == host_device) {
+            mpy_host_pool_free(dst_stage, nbytes);
+        }
+        else {
+            mpy_free_cache(dst_stage, nbytes, dst_device);
+        }
+    }
+
+    return ret;
+}
+
+/*
+ * Returns 1 if a cross-device assignment should cast on the source side,
+ * 0 if it should send the source items and cast on the destination side.
+ * The side is picked so that the narrower type crosses the link.
+ */
+static int
+cast_on_source_side(PyArray_Descr *dst_dtype, PyArray_Descr *src_dtype)
+{
+    return dst_dtype->elsize <= src_dtype->elsize;
 }
 
 /*
@@ -932,18 +1307,23 @@ _AssignArrayFromAnotherDevice(PyMicArrayObject *dst, PyArrayObject *src,
     }
 
     /*
-     * When source dtype is not equal dest dtype,
-     * we make a temporary copy of 'src'
+     * When source dtype is not equal dest dtype and the destination type
+     * is not wider, cast into a temporary copy of 'src' before sending it.
+     * Otherwise the source items are sent and cast on the destination.
      */
-    if (PyArray_TYPE(src) != PyMicArray_TYPE(dst)) {
+    if (!PyArray_EquivTypes(PyArray_DESCR(src), PyMicArray_DESCR(dst)) &&
+            cast_on_source_side(PyMicArray_DESCR(dst), PyArray_DESCR(src))) {
+        PyArray_Descr *dtype = PyMicArray_DESCR(dst);
+
+        Py_INCREF(dtype);
         if (device == host_device) {
             PyArrayObject *tmp;
 
             /*
             * Allocate a temporary copy array.
             */
-            tmp = (PyArrayObject *)PyArray_NewLikeArray((PyArrayObject *) dst,
-                                            NPY_KEEPORDER, NULL, 0);
+            tmp = (PyArrayObject *)PyArray_NewLikeArray(src,
+                                            NPY_KEEPORDER, dtype, 0);
             if (tmp == NULL) {
                 goto fail;
             }
@@ -958,9 +1338,11 @@ _AssignArrayFromAnotherDevice(PyMicArrayObject *dst, PyArrayObject *src,
             PyMicArrayObject *tmp;
 
             tmp = (PyMicArrayObject *)PyMicArray_NewLikeArray(
-                                            device,
-                                            (PyArrayObject *) dst,
-                                            NPY_KEEPORDER, NULL, 0);
+                                            device, src,
+                                            NPY_KEEPORDER, dtype, 0);
+            if (tmp == NULL) {
+                goto fail;
+            }
             if (PyMicArray_CopyInto(tmp, (PyMicArrayObject *)src) < 0) {
                 Py_DECREF(tmp);
                 goto fail;
@@ -981,6 +1363,7 @@ _AssignArrayFromAnotherDevice(PyMicArrayObject *dst, PyArrayObject *src,
     if (raw_array_assign_device_array(PyMicArray_NDIM(dst), PyMicArray_DIMS(dst),
                 PyMicArray_DESCR(dst),
                 PyMicArray_DEVICE(dst), PyMicArray_BYTES(dst), PyMicArray_STRIDES(dst),
+                PyArray_DESCR(src),
                 device, PyArray_BYTES(src), src_strides) < 0) {
         goto fail;
     }
@@ -1038,7 +1421,7 @@ PyArray_AssignArrayFromDevice(PyArrayObject *dst, PyMicArrayObject *src,
                     NPY_CASTING casting)
 {
     int host_device;
-    PyArrayObject *org_dst = NULL;
+    int copied_src = 0;
 
     npy_intp src_strides[NPY_MAXDIMS];
 
@@ -1083,23 +1466,29 @@ PyArray_AssignArrayFromDevice(PyArrayObject *dst, PyMicArrayObject *src,
     }
 
     /*
-     * When source dtype is not equal dest dtype,
-     * we copy to an temporary array
+     * When source dtype is not equal dest dtype and the destination type
+     * is not wider, cast into a temporary on the device before sending.
+     * Otherwise the source items are sent and cast on the host.
      */
-    if (PyMicArray_TYPE(src) != PyArray_TYPE(dst)) {
-        PyArrayObject *tmp;
+    if (!PyArray_EquivTypes(PyMicArray_DESCR(src), PyArray_DESCR(dst)) &&
+            cast_on_source_side(PyArray_DESCR(dst), PyMicArray_DESCR(src))) {
+        PyArray_Descr *dtype = PyArray_DESCR(dst);
+        PyMicArrayObject *tmp;
 
-        /*
-         * Allocate a temporary copy array.
-         */
-        tmp = (PyArrayObject *)PyArray_NewLikeArray((PyArrayObject *) src,
-                                        NPY_KEEPORDER, NULL, 0);
+        Py_INCREF(dtype);
+        tmp = (PyMicArrayObject *)PyMicArray_NewLikeArray(
+                                        PyMicArray_DEVICE(src),
+                                        (PyArrayObject *) src,
+                                        NPY_KEEPORDER, dtype, 0);
         if (tmp == NULL) {
             goto fail;
         }
-
-        org_dst = dst;
-        dst = tmp;
+        if (PyMicArray_CopyInto(tmp, src) < 0) {
+            Py_DECREF(tmp);
+            goto fail;
+        }
+        src = tmp;
+        copied_src = 1;
     }
 
     /* Broadcast 'src' to 'dst' for raw iteration */
@@ -1114,26 +1503,19 @@ PyArray_AssignArrayFromDevice(PyArrayObject *dst, PyMicArrayObject *src,
     if (raw_array_assign_device_array(PyArray_NDIM(dst), PyArray_DIMS(dst),
                 PyArray_DESCR(dst),
                 host_device, PyArray_BYTES(dst), PyArray_STRIDES(dst),
+                PyMicArray_DESCR(src),
                 PyMicArray_DEVICE(src), PyMicArray_BYTES(src), src_strides) < 0) {
         goto fail;
     }
 
-
-    /*
-     * Copy to back to original 'dst'
-     */
-    if (org_dst) {
-        if (PyArray_CopyInto(org_dst, dst) < 0) {
-            goto fail;
-        }
-        Py_DECREF(dst);
+    if (copied_src) {
+        Py_DECREF(src);
     }
-
     return 0;
 
 fail:
-    if (org_dst) {
-        Py_DECREF(dst);
+    if (copied_src) {
+        Py_DECREF(src);
     }
     return -1;
 }
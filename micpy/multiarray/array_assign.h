@@ -108,5 +108,9 @@ raw_array_is_aligned(int ndim, char *data, npy_intp *strides, int alignment);
 NPY_NO_EXPORT int
 arrays_overlap(PyMicArrayObject *arr1, PyMicArrayObject *arr2);
 
+/* Size and duration of the last device to device copy */
+NPY_NO_EXPORT void
+mpy_get_peer_copy_stats(npy_intp *nbytes, double *seconds);
+
 
 #endif
@@ -38,6 +38,74 @@ power_of_ten(int n)
     return ret;
 }
 
+/*
+ * Arg-reduce every row of ap along axis with one offloaded call, reading
+ * the array in place instead of a transposed contiguous copy.
+ */
+static PyObject *
+_strided_arg_func(PyMicArrayObject *ap, int axis, PyMicArrayObject *out,
+                  PyMicArray_StridedArgFunc *arg_func, const char *name)
+{
+    PyMicArrayObject *rp = NULL;
+    npy_intp shape[NPY_MAXDIMS], strides[NPY_MAXDIMS];
+    npy_intp m;
+    int j, nd = 0;
+    int device = PyMicArray_DEVICE(ap);
+    NPY_BEGIN_THREADS_DEF;
+
+    m = PyMicArray_DIMS(ap)[axis];
+    if (m == 0) {
+        PyErr_Format(PyExc_ValueError,
+                "attempt to get %s of an empty sequence", name);
+        return NULL;
+    }
+    for (j = 0; j < PyMicArray_NDIM(ap); j++) {
+        if (j != axis) {
+            shape[nd] = PyMicArray_DIMS(ap)[j];
+            strides[nd] = PyMicArray_STRIDES(ap)[j];
+            nd++;
+        }
+    }
+
+    if (!out) {
+        rp = (PyMicArrayObject *)PyMicArray_New(device, Py_TYPE(ap), nd,
+                                          shape, NPY_INTP,
+                                          NULL, NULL, 0, 0,
+                                          (PyObject *)ap);
+        if (rp == NULL) {
+            return NULL;
+        }
+    }
+    else {
+        if ((PyMicArray_NDIM(out) != nd) ||
+                !PyArray_CompareLists(PyMicArray_DIMS(out), shape, nd)) {
+            PyErr_Format(PyExc_ValueError,
+                    "output array does not match result of mp.%s.", name);
+            return NULL;
+        }
+        rp = (PyMicArrayObject *)PyMicArray_FromArray(
+                              (PyArrayObject *)out,
+                              PyArray_DescrFromType(NPY_INTP), device,
+                              NPY_ARRAY_CARRAY | NPY_ARRAY_UPDATEIFCOPY);
+        if (rp == NULL) {
+            return NULL;
+        }
+    }
+
+    NPY_BEGIN_THREADS_DESCR(PyMicArray_DESCR(ap));
+    arg_func(PyMicArray_DATA(ap), m, PyMicArray_STRIDES(ap)[axis],
+             nd, shape, strides, (npy_intp *)PyMicArray_DATA(rp), device);
+    NPY_END_THREADS_DESCR(PyMicArray_DESCR(ap));
+
+    /* Trigger the UPDATEIFCOPY if necessary */
+    if (out != NULL && out != rp) {
+        Py_DECREF(rp);
+        rp = out;
+        Py_INCREF(rp);
+    }
+    return (PyObject *)rp;
+}
+
 /*NUMPY_API
  * ArgMax
  */
@@ -46,6 +114,8 @@ PyMicArray_ArgMax(PyMicArrayObject *op, int axis, PyMicArrayObject *out)
 {
     PyMicArrayObject *ap = NULL, *rp = NULL;
     PyMicArray_ArgFunc* arg_func;
+    PyMicArray_StridedArgFunc *strided_func;
+    PyObject *ret;
     char *ip;
     npy_intp *rptr;
     npy_intp i, n, m;
@@ -56,6 +126,15 @@ PyMicArray_ArgMax(PyMicArrayObject *op, int axis, PyMicArrayObject *out)
     if ((ap = (PyMicArrayObject *)PyMicArray_CheckAxis(op, &axis, 0)) == NULL) {
         return NULL;
     }
+
+    /* Aligned native data is reduced in place, with all rows at once */
+    strided_func = PyMicArray_GetArrFuncs(PyMicArray_TYPE(ap))->stridedargmax;
+    if (strided_func != NULL && PyMicArray_ISBEHAVED_RO(ap)) {
+        ret = _strided_arg_func(ap, axis, out, strided_func, "argmax");
+        Py_DECREF(ap);
+        return ret;
+    }
+
     /*
      * We need to permute the array so that axis is placed at the end.
      * And all other dimensions are shifted left.
@@ -168,6 +247,8 @@ PyMicArray_ArgMin(PyMicArrayObject *op, int axis, PyMicArrayObject *out)
 {
     PyMicArrayObject *ap = NULL, *rp = NULL;
     PyMicArray_ArgFunc* arg_func;
+    PyMicArray_StridedArgFunc *strided_func;
+    PyObject *ret;
     char *ip;
     npy_intp *rptr;
     npy_intp i, n, m;
@@ -178,6 +259,15 @@ PyMicArray_ArgMin(PyMicArrayObject *op, int axis, PyMicArrayObject *out)
     if ((ap = (PyMicArrayObject *)PyMicArray_CheckAxis(op, &axis, 0)) == NULL) {
         return NULL;
     }
+
+    /* Aligned native data is reduced in place, with all rows at once */
+    strided_func = PyMicArray_GetArrFuncs(PyMicArray_TYPE(ap))->stridedargmin;
+    if (strided_func != NULL && PyMicArray_ISBEHAVED_RO(ap)) {
+        ret = _strided_arg_func(ap, axis, out, strided_func, "argmin");
+        Py_DECREF(ap);
+        return ret;
+    }
+
     /*
      * We need to permute the array so that axis is placed at the end.
      * And all other dimensions are shifted left.
@@ -375,8 +465,16 @@ PyMicArray_Prod(PyMicArrayObject *self, int axis, int rtype, PyMicArrayObject *o
 NPY_NO_EXPORT PyObject *
 PyMicArray_CumSum(PyMicArrayObject *self, int axis, int rtype, PyMicArrayObject *out)
 {
-    //TODO
-    return NULL;
+    PyObject *arr, *ret;
+
+    arr = PyMicArray_CheckAxis(self, &axis, 0);
+    if (arr == NULL) {
+        return NULL;
+    }
+    ret = PyMicArray_GenericAccumulateFunction((PyMicArrayObject *)arr,
+                                               n_ops.add, axis, rtype, out);
+    Py_DECREF(arr);
+    return ret;
 }
 
 /*NUMPY_API
@@ -385,8 +483,16 @@ PyMicArray_CumSum(PyMicArrayObject *self, int axis, int rtype, PyMicArrayObject
 NPY_NO_EXPORT PyObject *
 PyMicArray_CumProd(PyMicArrayObject *self, int axis, int rtype, PyMicArrayObject *out)
 {
-    //TODO
-    return NULL;
+    PyObject *arr, *ret;
+
+    arr = PyMicArray_CheckAxis(self, &axis, 0);
+    if (arr == NULL) {
+        return NULL;
+    }
+    ret = PyMicArray_GenericAccumulateFunction((PyMicArrayObject *)arr,
+                                               n_ops.multiply, axis, rtype, out);
+    Py_DECREF(arr);
+    return ret;
 }
 
 /*NUMPY_API
@@ -247,6 +247,42 @@ end:
     Py_XDECREF(shape2_j);
 }
 
+/*
+ * Checks that an 'out' array has exactly the shape of the result.
+ * Returns 0 on success, -1 with a ValueError set otherwise.
+ */
+NPY_NO_EXPORT int
+check_out_shape(int ndim, npy_intp *dims, int out_ndim, npy_intp *out_dims)
+{
+    PyObject *errmsg, *shape1, *shape2;
+
+    if (ndim == out_ndim && PyArray_CompareLists(dims, out_dims, ndim)) {
+        return 0;
+    }
+
+    shape1 = convert_shape_to_string(out_ndim, out_dims, "");
+    shape2 = convert_shape_to_string(ndim, dims, "");
+    if (shape1 == NULL || shape2 == NULL) {
+        Py_XDECREF(shape1);
+        Py_XDECREF(shape2);
+        PyErr_SetString(PyExc_ValueError, "out array has the wrong shape");
+        return -1;
+    }
+
+    errmsg = PyUString_FromString("out array has shape ");
+    PyUString_ConcatAndDel(&errmsg, shape1);
+    PyUString_ConcatAndDel(&errmsg, PyUString_FromString(", expected "));
+    PyUString_ConcatAndDel(&errmsg, shape2);
+    if (errmsg != NULL) {
+        PyErr_SetObject(PyExc_ValueError, errmsg);
+        Py_DECREF(errmsg);
+    }
+    else {
+        PyErr_SetString(PyExc_ValueError, "out array has the wrong shape");
+    }
+    return -1;
+}
+
 /* Convert NPY_CASTING to string
  * borrow from numpy */
 NPY_NO_EXPORT const char *
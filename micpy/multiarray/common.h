@@ -18,6 +18,18 @@
 
 #define CPU_DEVICE (omp_get_initial_device())
 
+/*
+ * Host-device mode: memory of the initial device is ordinary host
+ * memory, so numpy and micpy arrays on it can share their buffers.
+ */
+#define MPY_IS_HOST_DEVICE(device) ((device) == CPU_DEVICE)
+
+/*
+ * Value of an optional device argument that was not given.  -1 can't be
+ * used, it is the initial device on some OpenMP runtimes.
+ */
+#define MPY_NO_DEVICE INT_MIN
+
 /*
  * Define a chunksize for CBLAS. CBLAS counts in integers.
  */
@@ -61,6 +73,9 @@ npy_casting_to_string(NPY_CASTING casting);
 NPY_NO_EXPORT void
 dot_alignment_error(PyMicArrayObject *a, int i, PyMicArrayObject *b, int j);
 
+NPY_NO_EXPORT int
+check_out_shape(int ndim, npy_intp *dims, int out_ndim, npy_intp *out_dims);
+
 NPY_NO_EXPORT int
 get_common_device2(PyObject *op1, PyObject *op2);
 
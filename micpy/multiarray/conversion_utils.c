@@ -68,7 +68,10 @@ PyMicArray_DeviceConverter(PyObject *object, int *device)
     }
 
     int dev = PyArray_PyIntAsInt(object);
-    if (dev >= 0 && dev < NDEVICES) {
+    if (error_converting(dev)) {
+        return NPY_FAIL;
+    }
+    if ((dev >= 0 && dev < NDEVICES) || MPY_IS_HOST_DEVICE(dev)) {
         *device = dev;
         return NPY_SUCCEED;
     }
@@ -869,6 +869,64 @@ PyMicArray_FromArrayAttr(PyObject *op, PyArray_Descr *typecode, PyObject *contex
     return NULL;
 }
 
+/*
+ * Wraps the data of the numpy array 'arr' as a micpy array on the
+ * host device 'device', keeping 'arr' as its base.  Like numpy.asarray,
+ * both arrays share memory, and the alias is read-only if 'arr' is.
+ * Only used when asked for, to_mic(alias=True), so that writes through
+ * a device array never reach a numpy array unless the caller wants it.
+ */
+NPY_NO_EXPORT PyObject *
+PyMicArray_AliasHostArray(PyArrayObject *arr, int device)
+{
+    PyArray_Descr *descr = PyArray_DESCR(arr);
+    PyMicArrayObject *ret;
+
+    Py_INCREF(descr);
+    ret = (PyMicArrayObject *)PyMicArray_NewFromDescr(device,
+                            &PyMicArray_Type, descr,
+                            PyArray_NDIM(arr), PyArray_DIMS(arr),
+                            PyArray_STRIDES(arr), PyArray_DATA(arr),
+                            PyArray_FLAGS(arr) & NPY_ARRAY_WRITEABLE, NULL);
+    if (ret == NULL) {
+        return NULL;
+    }
+    Py_INCREF(arr);
+    if (PyMicArray_SetBaseObject(ret, (PyObject *)arr) < 0) {
+        Py_DECREF(ret);
+        return NULL;
+    }
+
+    return (PyObject *)ret;
+}
+
+/*
+ * Wraps the data of 'arr', which lives on the host device, as a numpy
+ * array keeping 'arr' as its base.
+ */
+NPY_NO_EXPORT PyObject *
+PyMicArray_HostView(PyMicArrayObject *arr)
+{
+    PyArray_Descr *descr = PyMicArray_DESCR(arr);
+    PyArrayObject *ret;
+
+    Py_INCREF(descr);
+    ret = (PyArrayObject *)PyArray_NewFromDescr(&PyArray_Type, descr,
+                            PyMicArray_NDIM(arr), PyMicArray_DIMS(arr),
+                            PyMicArray_STRIDES(arr), PyMicArray_DATA(arr),
+                            PyMicArray_FLAGS(arr) & NPY_ARRAY_WRITEABLE, NULL);
+    if (ret == NULL) {
+        return NULL;
+    }
+    Py_INCREF(arr);
+    if (PyArray_SetBaseObject(ret, (PyObject *)arr) < 0) {
+        Py_DECREF(ret);
+        return NULL;
+    }
+
+    return (PyObject *)ret;
+}
+
 /* TODO: Put the order parameter in PyArray_CopyAnyInto and remove this */
 NPY_NO_EXPORT int
 PyMicArray_CopyAsFlat(PyMicArrayObject *dst, PyMicArrayObject *src, NPY_ORDER order)
@@ -64,6 +64,12 @@ PyMicArray_CopyInto(PyMicArrayObject *dst, PyMicArrayObject *src);
 NPY_NO_EXPORT int
 PyMicArray_CopyIntoHost(PyArrayObject *dst, PyMicArrayObject *src);
 
+NPY_NO_EXPORT PyObject *
+PyMicArray_AliasHostArray(PyArrayObject *arr, int device);
+
+NPY_NO_EXPORT PyObject *
+PyMicArray_HostView(PyMicArrayObject *arr);
+
 NPY_NO_EXPORT int
 PyMicArray_CopyIntoFromHost(PyMicArrayObject *dst, PyArrayObject *src);
 
@@ -183,6 +183,32 @@ array_priority_get(PyMicArrayObject *self)
     }
 }
 
+/*
+ * Only arrays on the host device can be read through the array interface,
+ * device memory is not addressable by the consumer.
+ */
+static PyObject *
+array_interface_get(PyMicArrayObject *self)
+{
+    PyArrayObject *view;
+    PyObject *ret;
+
+    if (!MPY_IS_HOST_DEVICE(PyMicArray_DEVICE(self))) {
+        PyErr_SetString(PyExc_AttributeError,
+                "__array_interface__ is only available for arrays "
+                "on the host device");
+        return NULL;
+    }
+
+    view = PyMicArray_HostView(self);
+    if (view == NULL) {
+        return NULL;
+    }
+    ret = PyObject_GetAttrString((PyObject *)view, "__array_interface__");
+    Py_DECREF(view);
+    return ret;
+}
+
 static PyObject *
 array_descr_get(PyMicArrayObject *self)
 {
@@ -669,11 +695,11 @@ NPY_NO_EXPORT PyGetSetDef array_getsetlist[] = {
         (getter)array_transpose_get,
         NULL,
         NULL, NULL},
-    /*TODO: keep or delete ?
     {"__array_interface__",
         (getter)array_interface_get,
         NULL,
         NULL, NULL},
+    /*TODO: keep or delete ?
     {"__array_struct__",
         (getter)array_struct_get,
         NULL,
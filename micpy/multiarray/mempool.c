@@ -0,0 +1,910 @@
+/*
+ * Caching allocator for array data on MIC devices.
+ *
+ * omp_target_alloc and omp_target_free are orders of magnitude slower
+ * than a host malloc, so freed device blocks are kept and handed out
+ * again.  Device memory is requested in segments.  A segment is split
+ * into blocks on allocation, and free neighbouring blocks of a segment
+ * are coalesced again on free.  All bookkeeping lives on the host,
+ * device memory itself is never touched.
+ *
+ * Free blocks are binned into geometric size classes (four classes per
+ * power of two), so in the common case an allocation is a list pop.
+ * Segments that are entirely free are only given back to the device
+ * when the pool limit would be exceeded, when the device runs out of
+ * memory or on MemoryPool.free_all_blocks().
+ *
+ * As the rest of the allocation cache, this assumes the GIL is held.
+ */
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include "structmember.h"
+
+#define NPY_NO_DEPRECATED_API NPY_API_VERSION
+#define NO_IMPORT_ARRAY
+#define PY_ARRAY_UNIQUE_SYMBOL MICPY_ARRAY_API
+#include <numpy/arrayobject.h>
+#include <numpy/npy_3kcompat.h>
+
+#define _MICARRAYMODULE
+#include "common.h"
+#include "conversion_utils.h"
+#include "templ_common.h" /* for npy_mul_with_overflow_intp */
+#include "alloc.h"
+#include "mempool.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* Every block size is a multiple of this, keeps split blocks aligned */
+#define MPY_POOL_ALIGN 512
+/* Requests below this share segments of MPY_POOL_SMALL_SEGMENT bytes */
+#define MPY_POOL_SMALL_LIMIT (1 << 20)
+#define MPY_POOL_SMALL_SEGMENT (2 << 20)
+/* Four size classes per power of two are more than enough for 64 bits */
+#define MPY_POOL_NCLASSES 256
+#define MPY_POOL_TABLE_INIT 256
+
+typedef struct _mpy_pool_block {
+    char *ptr;
+    npy_uintp size;
+    int allocated;
+    /* Address ordered neighbours inside the same segment */
+    struct _mpy_pool_block *prev, *next;
+    /* Links in the free list of the size class */
+    struct _mpy_pool_block *fprev, *fnext;
+    /* Chain in the table of allocated blocks */
+    struct _mpy_pool_block *hnext;
+} mpy_pool_block;
+
+typedef struct {
+    mpy_pool_block *free_lists[MPY_POOL_NCLASSES];
+    /* Allocated blocks keyed by device pointer */
+    mpy_pool_block **table;
+    npy_uintp table_size, table_count;
+    /* Bytes handed out, bytes kept in free blocks, high water mark */
+    npy_uintp used_bytes, cached_bytes, peak_bytes;
+    /* Upper bound on used + cached bytes, 0 means unlimited */
+    npy_uintp limit;
+} mpy_pool;
+
+static mpy_pool pools[NMAXDEVICES];
+
+static NPY_INLINE mpy_pool *
+_get_pool(int device)
+{
+    if (device < 0 || device >= NMAXDEVICES) {
+        return NULL;
+    }
+    return &pools[device];
+}
+
+/*
+ * Geometric size class: the leading bit and the two bits below it of
+ * the size in MPY_POOL_ALIGN units.  Classes are monotonic in size, so
+ * every block of a class above the class of a request is big enough.
+ */
+static NPY_INLINE int
+_pool_class(npy_uintp size)
+{
+    npy_uintp units = size / MPY_POOL_ALIGN;
+    int k = 0;
+
+    while ((units >> k) > 1) {
+        ++k;
+    }
+    if (k < 2) {
+        return (int)units - 1;
+    }
+    return 3 + 4*(k - 2) + (int)((units >> (k - 2)) & 3);
+}
+
+static NPY_INLINE npy_uintp
+_pool_hash(mpy_pool *pool, void *p)
+{
+    return ((npy_uintp)p >> 6) & (pool->table_size - 1);
+}
+
+static int
+_pool_table_grow(mpy_pool *pool)
+{
+    npy_uintp i, new_size;
+    mpy_pool_block **old_table = pool->table;
+    npy_uintp old_size = pool->table_size;
+
+    new_size = (old_size == 0) ? MPY_POOL_TABLE_INIT : 2*old_size;
+    pool->table = PyArray_malloc(new_size * sizeof(mpy_pool_block *));
+    if (pool->table == NULL) {
+        pool->table = old_table;
+        return -1;
+    }
+    memset(pool->table, 0, new_size * sizeof(mpy_pool_block *));
+    pool->table_size = new_size;
+
+    for (i = 0; i < old_size; ++i) {
+        mpy_pool_block *b = old_table[i];
+        while (b != NULL) {
+            mpy_pool_block *next = b->hnext;
+            npy_uintp h = _pool_hash(pool, b->ptr);
+            b->hnext = pool->table[h];
+            pool->table[h] = b;
+            b = next;
+        }
+    }
+    PyArray_free(old_table);
+    return 0;
+}
+
+static int
+_pool_table_insert(mpy_pool *pool, mpy_pool_block *b)
+{
+    npy_uintp h;
+
+    if (pool->table_count >= pool->table_size) {
+        if (_pool_table_grow(pool) < 0) {
+            return -1;
+        }
+    }
+    h = _pool_hash(pool, b->ptr);
+    b->hnext = pool->table[h];
+    pool->table[h] = b;
+    pool->table_count++;
+    return 0;
+}
+
+static mpy_pool_block *
+_pool_table_find(mpy_pool *pool, void *p, int remove)
+{
+    mpy_pool_block **link, *b;
+
+    if (pool->table_size == 0) {
+        return NULL;
+    }
+    link = &pool->table[_pool_hash(pool, p)];
+    for (b = *link; b != NULL; link = &b->hnext, b = b->hnext) {
+        if (b->ptr == p) {
+            if (remove) {
+                *link = b->hnext;
+                b->hnext = NULL;
+                pool->table_count--;
+            }
+            return b;
+        }
+    }
+    return NULL;
+}
+
+static void
+_pool_push_free(mpy_pool *pool, mpy_pool_block *b)
+{
+    int c = _pool_class(b->size);
+
+    b->fprev = NULL;
+    b->fnext = pool->free_lists[c];
+    if (b->fnext != NULL) {
+        b->fnext->fprev = b;
+    }
+    pool->free_lists[c] = b;
+}
+
+static void
+_pool_unlink_free(mpy_pool *pool, mpy_pool_block *b)
+{
+    if (b->fprev != NULL) {
+        b->fprev->fnext = b->fnext;
+    }
+    else {
+        pool->free_lists[_pool_class(b->size)] = b->fnext;
+    }
+    if (b->fnext != NULL) {
+        b->fnext->fprev = b->fprev;
+    }
+    b->fprev = b->fnext = NULL;
+}
+
+/*
+ * Give every entirely free segment back to the device.
+ * Returns the number of released bytes.
+ */
+static npy_uintp
+_pool_release_segments(mpy_pool *pool, int device)
+{
+    int c;
+    npy_uintp released = 0;
+
+    for (c = 0; c < MPY_POOL_NCLASSES; ++c) {
+        mpy_pool_block *b = pool->free_lists[c];
+        while (b != NULL) {
+            mpy_pool_block *next = b->fnext;
+            if (b->prev == NULL && b->next == NULL) {
+                _pool_unlink_free(pool, b);
+                PyDataMemMic_FREE(b->ptr, device);
+                pool->cached_bytes -= b->size;
+                released += b->size;
+                PyArray_free(b);
+            }
+            b = next;
+        }
+    }
+    return released;
+}
+
+/* Request a new segment from the device and put it in the free lists */
+static mpy_pool_block *
+_pool_new_segment(mpy_pool *pool, int device, npy_uintp size)
+{
+    mpy_pool_block *b;
+    npy_uintp segsize;
+    void *ptr;
+
+    segsize = (size < MPY_POOL_SMALL_LIMIT) ? MPY_POOL_SMALL_SEGMENT : size;
+
+    if (pool->limit != 0 &&
+            pool->used_bytes + pool->cached_bytes + segsize > pool->limit) {
+        _pool_release_segments(pool, device);
+        if (pool->used_bytes + pool->cached_bytes + size > pool->limit) {
+            return NULL;
+        }
+        if (pool->used_bytes + pool->cached_bytes + segsize > pool->limit) {
+            segsize = size;
+        }
+    }
+
+    b = PyArray_malloc(sizeof(mpy_pool_block));
+    if (b == NULL) {
+        return NULL;
+    }
+
+    ptr = PyDataMemMic_NEW(segsize, device);
+    if (ptr == NULL) {
+        /* Device is full, drop what we are caching and retry */
+        if (_pool_release_segments(pool, device) > 0) {
+            ptr = PyDataMemMic_NEW(segsize, device);
+        }
+        if (ptr == NULL && segsize > size) {
+            segsize = size;
+            ptr = PyDataMemMic_NEW(segsize, device);
+        }
+        if (ptr == NULL) {
+            PyArray_free(b);
+            return NULL;
+        }
+    }
+
+    b->ptr = ptr;
+    b->size = segsize;
+    b->allocated = 0;
+    b->prev = b->next = NULL;
+    b->hnext = NULL;
+    pool->cached_bytes += segsize;
+    _pool_push_free(pool, b);
+
+    return b;
+}
+
+static mpy_pool_block *
+_pool_find_free(mpy_pool *pool, npy_uintp size)
+{
+    int c = _pool_class(size);
+    mpy_pool_block *b;
+
+    /* Blocks in the class of the request may still be too small */
+    for (b = pool->free_lists[c]; b != NULL; b = b->fnext) {
+        if (b->size >= size) {
+            return b;
+        }
+    }
+    for (++c; c < MPY_POOL_NCLASSES; ++c) {
+        if (pool->free_lists[c] != NULL) {
+            return pool->free_lists[c];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Allocate size bytes of device memory through the pool.
+ * Returns NULL without setting an exception on failure.
+ */
+NPY_NO_EXPORT void *
+mpy_pool_malloc(npy_uintp size, int device)
+{
+    mpy_pool *pool = _get_pool(device);
+    mpy_pool_block *b;
+
+    if (pool == NULL) {
+        return PyDataMemMic_NEW(size, device);
+    }
+
+    /* Rounding up would wrap around, callers raise MemoryError */
+    if (size > NPY_MAX_UINTP - (MPY_POOL_ALIGN - 1)) {
+        return NULL;
+    }
+    /* Round up, zero sized requests still get a distinct block */
+    size = (size + MPY_POOL_ALIGN - 1) & ~((npy_uintp)MPY_POOL_ALIGN - 1);
+    if (size == 0) {
+        size = MPY_POOL_ALIGN;
+    }
+
+    b = _pool_find_free(pool, size);
+    if (b == NULL) {
+        b = _pool_new_segment(pool, device, size);
+        if (b == NULL) {
+            return NULL;
+        }
+    }
+    _pool_unlink_free(pool, b);
+
+    /* Split off the tail as a new free block */
+    if (b->size - size >= MPY_POOL_ALIGN) {
+        mpy_pool_block *rest = PyArray_malloc(sizeof(mpy_pool_block));
+        if (rest != NULL) {
+            rest->ptr = b->ptr + size;
+            rest->size = b->size - size;
+            rest->allocated = 0;
+            rest->prev = b;
+            rest->next = b->next;
+            rest->hnext = NULL;
+            if (b->next != NULL) {
+                b->next->prev = rest;
+            }
+            b->next = rest;
+            b->size = size;
+            _pool_push_free(pool, rest);
+        }
+    }
+
+    if (_pool_table_insert(pool, b) < 0) {
+        _pool_push_free(pool, b);
+        return NULL;
+    }
+    b->allocated = 1;
+    pool->cached_bytes -= b->size;
+    pool->used_bytes += b->size;
+    if (pool->used_bytes > pool->peak_bytes) {
+        pool->peak_bytes = pool->used_bytes;
+    }
+
+    return b->ptr;
+}
+
+/*
+ * Return a block to the pool, merging it with free neighbours.
+ * Pointers that were not allocated through the pool are freed directly.
+ */
+NPY_NO_EXPORT void
+mpy_pool_free(void *p, int device)
+{
+    mpy_pool *pool = _get_pool(device);
+    mpy_pool_block *b, *n;
+
+    if (p == NULL) {
+        return;
+    }
+    if (pool == NULL ||
+            (b = _pool_table_find(pool, p, 1)) == NULL) {
+        PyDataMemMic_FREE(p, device);
+        return;
+    }
+
+    b->allocated = 0;
+    pool->used_bytes -= b->size;
+    pool->cached_bytes += b->size;
+
+    /* Coalesce with the following block */
+    n = b->next;
+    if (n != NULL && !n->allocated) {
+        _pool_unlink_free(pool, n);
+        b->size += n->size;
+        b->next = n->next;
+        if (n->next != NULL) {
+            n->next->prev = b;
+        }
+        PyArray_free(n);
+    }
+
+    /* Coalesce with the preceding block */
+    n = b->prev;
+    if (n != NULL && !n->allocated) {
+        _pool_unlink_free(pool, n);
+        n->size += b->size;
+        n->next = b->next;
+        if (b->next != NULL) {
+            b->next->prev = n;
+        }
+        PyArray_free(b);
+        b = n;
+    }
+
+    _pool_push_free(pool, b);
+}
+
+/*
+ * Resize a pooled block, keeping the content up to the smaller size.
+ * Blocks that are already large enough are reused in place.
+ */
+NPY_NO_EXPORT void *
+mpy_pool_realloc(void *p, npy_uintp size, int device)
+{
+    mpy_pool *pool = _get_pool(device);
+    mpy_pool_block *b;
+    void *result;
+
+    if (p == NULL) {
+        return mpy_pool_malloc(size, device);
+    }
+    if (pool == NULL ||
+            (b = _pool_table_find(pool, p, 0)) == NULL) {
+        return PyDataMemMic_RENEW(p, size, device);
+    }
+    if (b->size >= size) {
+        return p;
+    }
+
+    result = mpy_pool_malloc(size, device);
+    if (result == NULL) {
+        return NULL;
+    }
+    target_memcpy(result, p, b->size, device, device);
+    mpy_pool_free(p, device);
+
+    return result;
+}
+
+/* Release all cached device memory that is not in use */
+NPY_NO_EXPORT void
+mpy_pool_free_all_blocks(int device)
+{
+    mpy_pool *pool = _get_pool(device);
+
+    if (pool != NULL) {
+        _pool_release_segments(pool, device);
+    }
+}
+
+
+/******************* Pinned host staging buffers *******************/
+
+/*
+ * Host buffers used to stage transfers.  They are page aligned, faulted
+ * in and locked when first allocated, so reusing one never pays for page
+ * faults again.  Freed buffers are cached by size class up to
+ * MPY_HOST_POOL_MAX_CACHED bytes.
+ */
+#define MPY_HOST_POOL_MAX_CACHED ((npy_uintp)256 << 20)
+
+typedef struct _mpy_host_buffer {
+    void *ptr;
+    struct _mpy_host_buffer *next;
+} mpy_host_buffer;
+
+static mpy_host_buffer *host_free_lists[MPY_POOL_NCLASSES];
+static npy_uintp host_cached_bytes = 0;
+static npy_uintp host_page_size = 0;
+
+/*
+ * Rounds size up to the upper bound of its size class, counted in
+ * pages, so any cached buffer of a class fits every request of it.
+ */
+static npy_uintp
+_host_pool_round(npy_uintp size, int *cls)
+{
+    npy_uintp units;
+    int k = 0;
+
+    if (host_page_size == 0) {
+        long ps = sysconf(_SC_PAGESIZE);
+        host_page_size = (ps > 0) ? (npy_uintp)ps : 4096;
+    }
+
+    units = (size + host_page_size - 1) / host_page_size;
+    if (units == 0) {
+        units = 1;
+    }
+    while ((units >> k) > 1) {
+        ++k;
+    }
+    if (k >= 2) {
+        npy_uintp gran = (npy_uintp)1 << (k - 2);
+        units = (units + gran - 1) & ~(gran - 1);
+        k = 0;
+        while ((units >> k) > 1) {
+            ++k;
+        }
+    }
+
+    *cls = (k < 2) ? (int)units - 1 : 3 + 4*(k - 2) +
+                                      (int)((units >> (k - 2)) & 3);
+    return units * host_page_size;
+}
+
+/*
+ * Allocate a page aligned, locked host buffer of at least size bytes.
+ * Returns NULL without setting an exception on failure.
+ */
+NPY_NO_EXPORT void *
+mpy_host_pool_malloc(npy_uintp size)
+{
+    mpy_host_buffer *node;
+    void *p;
+    npy_uintp i;
+    int cls;
+
+    size = _host_pool_round(size, &cls);
+
+    node = host_free_lists[cls];
+    if (node != NULL) {
+        host_free_lists[cls] = node->next;
+        host_cached_bytes -= size;
+        p = node->ptr;
+        PyArray_free(node);
+        return p;
+    }
+
+    if (posix_memalign(&p, host_page_size, size) != 0) {
+        return NULL;
+    }
+    /* Fault every page in now, locking is best effort */
+    for (i = 0; i < size; i += host_page_size) {
+        ((volatile char *)p)[i] = 0;
+    }
+    mlock(p, size);
+
+    return p;
+}
+
+/* Return a buffer of the given request size to the host pool */
+NPY_NO_EXPORT void
+mpy_host_pool_free(void *p, npy_uintp size)
+{
+    mpy_host_buffer *node;
+    int cls;
+
+    if (p == NULL) {
+        return;
+    }
+
+    size = _host_pool_round(size, &cls);
+    if (host_cached_bytes + size <= MPY_HOST_POOL_MAX_CACHED) {
+        node = PyArray_malloc(sizeof(mpy_host_buffer));
+        if (node != NULL) {
+            node->ptr = p;
+            node->next = host_free_lists[cls];
+            host_free_lists[cls] = node;
+            host_cached_bytes += size;
+            return;
+        }
+    }
+
+    munlock(p, size);
+    free(p);
+}
+
+static void
+_pinned_capsule_destructor(PyObject *capsule)
+{
+    mpy_host_pool_free(PyCapsule_GetPointer(capsule, NULL),
+                       (npy_uintp)PyCapsule_GetContext(capsule));
+}
+
+/*
+ * New numpy array of 'descr' (stolen) backed by a pinned pool buffer,
+ * C contiguous or Fortran contiguous if 'fortran' is set.
+ */
+static PyArrayObject *
+_pinned_array_new(PyArray_Descr *descr, int nd, npy_intp *dims,
+                  int fortran)
+{
+    PyObject *ret, *capsule;
+    npy_intp nbytes = descr->elsize;
+    void *data;
+    int i;
+
+    /* Same checks as PyMicArray_NewFromDescr */
+    for (i = 0; i < nd; i++) {
+        if (dims[i] < 0) {
+            PyErr_SetString(PyExc_ValueError,
+                "negative dimensions are not allowed");
+            Py_DECREF(descr);
+            return NULL;
+        }
+        if (npy_mul_with_overflow_intp(&nbytes, nbytes, dims[i])) {
+            PyErr_SetString(PyExc_ValueError,
+                "array is too big; `arr.size * arr.dtype.itemsize` "
+                "is larger than the maximum possible size.");
+            Py_DECREF(descr);
+            return NULL;
+        }
+    }
+
+    data = mpy_host_pool_malloc(nbytes);
+    if (data == NULL) {
+        Py_DECREF(descr);
+        PyErr_NoMemory();
+        return NULL;
+    }
+    capsule = PyCapsule_New(data, NULL, _pinned_capsule_destructor);
+    if (capsule == NULL) {
+        Py_DECREF(descr);
+        mpy_host_pool_free(data, nbytes);
+        return NULL;
+    }
+    PyCapsule_SetContext(capsule, (void *)nbytes);
+
+    ret = PyArray_NewFromDescr(&PyArray_Type, descr, nd, dims, NULL, data,
+                               fortran ? NPY_ARRAY_FARRAY : NPY_ARRAY_CARRAY,
+                               NULL);
+    if (ret == NULL ||
+            PyArray_SetBaseObject((PyArrayObject *)ret, capsule) < 0) {
+        Py_XDECREF(ret);
+        Py_DECREF(capsule);
+        return NULL;
+    }
+    return (PyArrayObject *)ret;
+}
+
+/*
+ * Uninitialized pinned host array with the shape of 'prototype', which
+ * may be a numpy or a device array, and dtype 'dtype' (stolen) or the
+ * prototype's when NULL. The result is contiguous, Fortran ordered only
+ * if the prototype is, so a device to host copy into it is one transfer.
+ */
+NPY_NO_EXPORT PyArrayObject *
+mpy_pinned_like(PyArrayObject *prototype, PyArray_Descr *dtype)
+{
+    int fortran = PyArray_NDIM(prototype) > 1 &&
+                  PyArray_IS_F_CONTIGUOUS(prototype) &&
+                  !PyArray_IS_C_CONTIGUOUS(prototype);
+
+    if (dtype == NULL) {
+        dtype = PyArray_DESCR(prototype);
+        Py_INCREF(dtype);
+    }
+    return _pinned_array_new(dtype, PyArray_NDIM(prototype),
+                             PyArray_DIMS(prototype), fortran);
+}
+
+/*
+ * micpy.empty_pinned(shape, dtype=float, order='C')
+ * Returns an uninitialized numpy array backed by a pinned staging buffer,
+ * the buffer goes back to the pool when the array is released.
+ * Contiguous uploads read the caller's buffer in place, so sources that
+ * are sent repeatedly should be allocated here to be sent from pinned
+ * memory.
+ */
+NPY_NO_EXPORT PyObject *
+array_empty_pinned(PyObject *NPY_UNUSED(ignored), PyObject *args,
+                   PyObject *kwds)
+{
+    static char *kwlist[] = {"shape", "dtype", "order", NULL};
+    PyArray_Dims shape = {NULL, 0};
+    PyArray_Descr *typecode = NULL;
+    NPY_ORDER order = NPY_CORDER;
+    PyArrayObject *ret = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&|O&O&", kwlist,
+                PyArray_IntpConverter, &shape,
+                PyArray_DescrConverter, &typecode,
+                PyArray_OrderConverter, &order)) {
+        goto fail;
+    }
+    if (order != NPY_CORDER && order != NPY_FORTRANORDER) {
+        PyErr_SetString(PyExc_ValueError,
+                "only 'C' or 'F' order is permitted");
+        goto fail;
+    }
+    if (typecode == NULL) {
+        typecode = PyArray_DescrFromType(NPY_DEFAULT_TYPE);
+    }
+
+    ret = _pinned_array_new(typecode, shape.len, shape.ptr,
+                            order == NPY_FORTRANORDER);
+    typecode = NULL;
+
+fail:
+    Py_XDECREF(typecode);
+    PyDimMem_FREE(shape.ptr);
+    return (PyObject *)ret;
+}
+
+
+/******************* MemoryPool python object *******************/
+
+typedef struct {
+    PyObject_HEAD
+    int device;
+} PyMicMemoryPoolObject;
+
+#define POOL_OF(self) (&pools[((PyMicMemoryPoolObject *)(self))->device])
+
+static PyObject *
+mempool_used_bytes(PyObject *self, PyObject *NPY_UNUSED(args))
+{
+    return PyLong_FromUnsignedLongLong(POOL_OF(self)->used_bytes);
+}
+
+static PyObject *
+mempool_cached_bytes(PyObject *self, PyObject *NPY_UNUSED(args))
+{
+    return PyLong_FromUnsignedLongLong(POOL_OF(self)->cached_bytes);
+}
+
+static PyObject *
+mempool_total_bytes(PyObject *self, PyObject *NPY_UNUSED(args))
+{
+    mpy_pool *pool = POOL_OF(self);
+    return PyLong_FromUnsignedLongLong(pool->used_bytes + pool->cached_bytes);
+}
+
+static PyObject *
+mempool_peak_bytes(PyObject *self, PyObject *NPY_UNUSED(args))
+{
+    return PyLong_FromUnsignedLongLong(POOL_OF(self)->peak_bytes);
+}
+
+static PyObject *
+mempool_reset_peak(PyObject *self, PyObject *NPY_UNUSED(args))
+{
+    mpy_pool *pool = POOL_OF(self);
+    pool->peak_bytes = pool->used_bytes;
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+mempool_free_all_blocks(PyObject *self, PyObject *NPY_UNUSED(args))
+{
+    mpy_pool_free_all_blocks(((PyMicMemoryPoolObject *)self)->device);
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+mempool_get_limit(PyObject *self, PyObject *NPY_UNUSED(args))
+{
+    return PyLong_FromUnsignedLongLong(POOL_OF(self)->limit);
+}
+
+static PyObject *
+mempool_set_limit(PyObject *self, PyObject *args)
+{
+    unsigned long long limit;
+    mpy_pool *pool = POOL_OF(self);
+
+    if (!PyArg_ParseTuple(args, "K", &limit)) {
+        return NULL;
+    }
+    pool->limit = (npy_uintp)limit;
+    if (limit != 0 && pool->used_bytes + pool->cached_bytes > limit) {
+        _pool_release_segments(pool, ((PyMicMemoryPoolObject *)self)->device);
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+mempool_repr(PyObject *self)
+{
+    mpy_pool *pool = POOL_OF(self);
+    char buf[160];
+
+    PyOS_snprintf(buf, sizeof(buf),
+            "MemoryPool(device=%d, used=%llu, cached=%llu, peak=%llu)",
+            ((PyMicMemoryPoolObject *)self)->device,
+            (unsigned long long)pool->used_bytes,
+            (unsigned long long)pool->cached_bytes,
+            (unsigned long long)pool->peak_bytes);
+    return PyUString_FromString(buf);
+}
+
+static PyObject *
+mempool_device_get(PyObject *self)
+{
+    return PyInt_FromLong(((PyMicMemoryPoolObject *)self)->device);
+}
+
+static PyMethodDef mempool_methods[] = {
+    {"used_bytes",
+        (PyCFunction)mempool_used_bytes,
+        METH_NOARGS, "Bytes currently held by arrays."},
+    {"cached_bytes",
+        (PyCFunction)mempool_cached_bytes,
+        METH_NOARGS, "Bytes kept in free blocks for reuse."},
+    {"total_bytes",
+        (PyCFunction)mempool_total_bytes,
+        METH_NOARGS, "Bytes allocated from the device."},
+    {"peak_bytes",
+        (PyCFunction)mempool_peak_bytes,
+        METH_NOARGS, "Highest value of used_bytes since the last reset."},
+    {"reset_peak",
+        (PyCFunction)mempool_reset_peak,
+        METH_NOARGS, NULL},
+    {"free_all_blocks",
+        (PyCFunction)mempool_free_all_blocks,
+        METH_NOARGS, "Release all cached memory that is not in use."},
+    {"get_limit",
+        (PyCFunction)mempool_get_limit,
+        METH_NOARGS, NULL},
+    {"set_limit",
+        (PyCFunction)mempool_set_limit,
+        METH_VARARGS, "Cap used + cached bytes, 0 disables the cap."},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyGetSetDef mempool_getset[] = {
+    {"device",
+        (getter)mempool_device_get,
+        NULL, NULL, NULL},
+    {NULL, NULL, NULL, NULL, NULL},
+};
+
+NPY_NO_EXPORT PyTypeObject PyMicMemoryPool_Type = {
+#if defined(NPY_PY3K)
+    PyVarObject_HEAD_INIT(NULL, 0)
+#else
+    PyObject_HEAD_INIT(NULL)
+    0,                                          /* ob_size */
+#endif
+    "micpy.MemoryPool",                         /* tp_name */
+    sizeof(PyMicMemoryPoolObject),              /* tp_basicsize */
+    0,                                          /* tp_itemsize */
+    /* methods */
+    0,                                          /* tp_dealloc */
+    (printfunc)NULL,                            /* tp_print */
+    0,                                          /* tp_getattr */
+    0,                                          /* tp_setattr */
+#if defined(NPY_PY3K)
+    0,                                          /* tp_reserved */
+#else
+    0,                                          /* tp_compare */
+#endif
+    (reprfunc)mempool_repr,                     /* tp_repr */
+    0,                                          /* tp_as_number */
+    0,                                          /* tp_as_sequence */
+    0,                                          /* tp_as_mapping */
+    0,                                          /* tp_hash */
+    0,                                          /* tp_call */
+    0,                                          /* tp_str */
+    0,                                          /* tp_getattro */
+    0,                                          /* tp_setattro */
+    0,                                          /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                         /* tp_flags */
+    0,                                          /* tp_doc */
+    0,                                          /* tp_traverse */
+    0,                                          /* tp_clear */
+    0,                                          /* tp_richcompare */
+    0,                                          /* tp_weaklistoffset */
+    0,                                          /* tp_iter */
+    0,                                          /* tp_iternext */
+    mempool_methods,                            /* tp_methods */
+    0,                                          /* tp_members */
+    mempool_getset,                             /* tp_getset */
+};
+
+/*
+ * micpy.memory_pool(device=None)
+ * Returns the MemoryPool object of the device (current device by default)
+ */
+NPY_NO_EXPORT PyObject *
+array_memory_pool(PyObject *NPY_UNUSED(ignored), PyObject *args,
+                  PyObject *kwds)
+{
+    static char *kwlist[] = {"device", NULL};
+    int device = DEFAULT_DEVICE;
+    PyMicMemoryPoolObject *ret;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O&", kwlist,
+                &PyMicArray_DeviceConverter, &device)) {
+        return NULL;
+    }
+    if (_get_pool(device) == NULL) {
+        PyErr_Format(PyExc_ValueError,
+                "no memory pool for device %d", device);
+        return NULL;
+    }
+
+    ret = PyObject_New(PyMicMemoryPoolObject, &PyMicMemoryPool_Type);
+    if (ret == NULL) {
+        return NULL;
+    }
+    ret->device = device;
+
+    return (PyObject *)ret;
+}
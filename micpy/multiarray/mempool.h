@@ -0,0 +1,42 @@
+#ifndef _MPY_MEMPOOL_H_
+#define _MPY_MEMPOOL_H_
+
+#include <numpy/ndarraytypes.h>
+
+/*
+ * Caching allocator for device array data, one pool per device.
+ * All functions assume the GIL is held.
+ */
+NPY_NO_EXPORT void *
+mpy_pool_malloc(npy_uintp size, int device);
+
+NPY_NO_EXPORT void *
+mpy_pool_realloc(void *p, npy_uintp size, int device);
+
+NPY_NO_EXPORT void
+mpy_pool_free(void *p, int device);
+
+NPY_NO_EXPORT void
+mpy_pool_free_all_blocks(int device);
+
+/* Pinned, page aligned host buffers for staging transfers */
+NPY_NO_EXPORT void *
+mpy_host_pool_malloc(npy_uintp size);
+
+NPY_NO_EXPORT void
+mpy_host_pool_free(void *p, npy_uintp size);
+
+NPY_NO_EXPORT PyArrayObject *
+mpy_pinned_like(PyArrayObject *prototype, PyArray_Descr *dtype);
+
+extern NPY_NO_EXPORT PyTypeObject PyMicMemoryPool_Type;
+
+NPY_NO_EXPORT PyObject *
+array_memory_pool(PyObject *NPY_UNUSED(ignored), PyObject *args,
+                  PyObject *kwds);
+
+NPY_NO_EXPORT PyObject *
+array_empty_pinned(PyObject *NPY_UNUSED(ignored), PyObject *args,
+                   PyObject *kwds);
+
+#endif
@@ -24,6 +24,8 @@
 #include "calculation.h"
 #include "multiarraymodule.h"
 #include "number.h"
+#include "mpy_dlpack.h"
+#include "mempool.h"
 
 
 /* NpyArg_ParseKeywords
@@ -1372,10 +1374,46 @@ array_newbyteorder(PyMicArrayObject *self, PyObject *args)
 
 
 static PyObject *
-array_tohost(PyMicArrayObject *self, PyObject *args)
+array_tohost(PyMicArrayObject *self, PyObject *args, PyObject *kwds)
 {
-    PyArrayObject *ret = (PyArrayObject *)PyArray_NewLikeArray((PyArrayObject *) self,
-                                NPY_KEEPORDER, NULL, 0);
+    static char *kwlist[] = {"out", "alias", NULL};
+    PyObject *out = Py_None;
+    npy_bool alias = NPY_FALSE;
+    PyArrayObject *ret;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OO&", kwlist, &out,
+                                     &PyArray_BoolConverter, &alias)) {
+        return NULL;
+    }
+
+    /* Download into an existing host array, casting if needed */
+    if (out != Py_None) {
+        if (!PyArray_Check(out)) {
+            PyErr_SetString(PyExc_TypeError,
+                    "out must be a numpy.ndarray");
+            return NULL;
+        }
+        if (check_out_shape(PyMicArray_NDIM(self), PyMicArray_DIMS(self),
+                            PyArray_NDIM((PyArrayObject *)out),
+                            PyArray_DIMS((PyArrayObject *)out)) < 0) {
+            return NULL;
+        }
+        if (PyMicArray_CopyIntoHost((PyArrayObject *)out, self) < 0) {
+            return NULL;
+        }
+        Py_INCREF(out);
+        return out;
+    }
+
+    /* Host-device mode, share the buffer if asked to */
+    if (alias && MPY_IS_HOST_DEVICE(PyMicArray_DEVICE(self))) {
+        return PyMicArray_HostView(self);
+    }
+
+    ret = mpy_pinned_like((PyArrayObject *) self, NULL);
+    if (ret == NULL) {
+        return NULL;
+    }
 
     if (PyMicArray_CopyIntoHost(ret, self) < 0){
         Py_XDECREF(ret);
@@ -1386,6 +1424,39 @@ array_tohost(PyMicArrayObject *self, PyObject *args)
 }
 
 
+static PyObject *
+array_todevice(PyMicArrayObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"device", NULL};
+    int device = -1;
+    PyMicArrayObject *ret;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&", kwlist,
+                                     &PyMicArray_DeviceConverter, &device)) {
+        return NULL;
+    }
+
+    /* Already there */
+    if (device == PyMicArray_DEVICE(self)) {
+        Py_INCREF(self);
+        return (PyObject *)self;
+    }
+
+    ret = (PyMicArrayObject *)PyMicArray_NewLikeArray(device,
+                                (PyArrayObject *) self,
+                                NPY_KEEPORDER, NULL, 0);
+    if (ret == NULL) {
+        return NULL;
+    }
+    if (PyMicArray_CopyInto(ret, self) < 0) {
+        Py_DECREF(ret);
+        return NULL;
+    }
+
+    return (PyObject *)ret;
+}
+
+
 static PyObject *
 array_complex(PyArrayObject *self, PyObject *NPY_UNUSED(args))
 {
@@ -1469,13 +1540,13 @@ NPY_NO_EXPORT PyMethodDef array_methods[] = {
     {"copy",
         (PyCFunction)array_copy,
         METH_VARARGS | METH_KEYWORDS, NULL},
-    /*{"cumprod",
+    {"cumprod",
         (PyCFunction)array_cumprod,
         METH_VARARGS | METH_KEYWORDS, NULL},
     {"cumsum",
         (PyCFunction)array_cumsum,
         METH_VARARGS | METH_KEYWORDS, NULL},
-    {"diagonal",
+    /*{"diagonal",
         (PyCFunction)array_diagonal,
         METH_VARARGS | METH_KEYWORDS, NULL},*/
     {"dot",
@@ -1589,6 +1660,15 @@ NPY_NO_EXPORT PyMethodDef array_methods[] = {
         METH_VARARGS | METH_KEYWORDS, NULL},
     {"to_cpu",
         (PyCFunction)array_tohost,
+        METH_VARARGS | METH_KEYWORDS, NULL},
+    {"to_device",
+        (PyCFunction)array_todevice,
+        METH_VARARGS | METH_KEYWORDS, NULL},
+    {"__dlpack__",
+        (PyCFunction)array_dlpack,
+        METH_VARARGS | METH_KEYWORDS, NULL},
+    {"__dlpack_device__",
+        (PyCFunction)array_dlpack_device,
         METH_NOARGS, NULL},
     {NULL, NULL, 0, NULL}           /* sentinel */
 };
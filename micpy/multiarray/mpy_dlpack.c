@@ -0,0 +1,397 @@
+/*
+ * DLPack export and import of micpy arrays.
+ *
+ * Arrays on a MIC device are described as kDLExtDev tensors with the
+ * device number as id.  Arrays on the host device (host-device mode) are
+ * plain kDLCPU tensors, so numpy.from_dlpack can consume them directly.
+ * Nothing is copied in either direction.
+ *
+ * DLPack 0.8 has no way to mark a tensor read-only, so read-only arrays
+ * are not exported, and imported arrays are only writeable when their
+ * producer is.
+ */
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#define NPY_NO_DEPRECATED_API NPY_API_VERSION
+#define NO_IMPORT_ARRAY
+#define PY_ARRAY_UNIQUE_SYMBOL MICPY_ARRAY_API
+#include <numpy/arrayobject.h>
+#include <numpy/npy_3kcompat.h>
+
+#define _MICARRAYMODULE
+#include "common.h"
+#include "arrayobject.h"
+#include "creators.h"
+#include "stream.h"
+#include "dlpack.h"
+#include "mpy_dlpack.h"
+
+#define DLPACK_CAPSULE_NAME "dltensor"
+#define DLPACK_USED_CAPSULE_NAME "used_dltensor"
+
+/* Exported tensor together with the storage it points to */
+typedef struct {
+    DLManagedTensor tensor;
+    int64_t shape[NPY_MAXDIMS];
+    int64_t strides[NPY_MAXDIMS];
+} mpy_dlpack_export;
+
+/* May be called by the consumer from any thread */
+static void
+_dlpack_deleter(DLManagedTensor *self)
+{
+    PyGILState_STATE state = PyGILState_Ensure();
+
+    Py_XDECREF((PyObject *)self->manager_ctx);
+    free(self);
+
+    PyGILState_Release(state);
+}
+
+/* Frees a capsule that was never consumed */
+static void
+_dlpack_capsule_destructor(PyObject *capsule)
+{
+    DLManagedTensor *tensor;
+    PyObject *type, *value, *traceback;
+
+    if (PyCapsule_IsValid(capsule, DLPACK_USED_CAPSULE_NAME)) {
+        return;
+    }
+
+    PyErr_Fetch(&type, &value, &traceback);
+    tensor = (DLManagedTensor *)PyCapsule_GetPointer(capsule,
+                                                     DLPACK_CAPSULE_NAME);
+    if (tensor == NULL) {
+        PyErr_WriteUnraisable(capsule);
+    }
+    else if (tensor->deleter != NULL) {
+        tensor->deleter(tensor);
+    }
+    PyErr_Restore(type, value, traceback);
+}
+
+/* Base object of imported arrays, gives the tensor back to its producer */
+static void
+_dlpack_used_capsule_destructor(PyObject *capsule)
+{
+    DLManagedTensor *tensor = (DLManagedTensor *)PyCapsule_GetPointer(
+                                        capsule, DLPACK_USED_CAPSULE_NAME);
+    if (tensor != NULL && tensor->deleter != NULL) {
+        tensor->deleter(tensor);
+    }
+}
+
+static DLDevice
+_dlpack_device_of(int device)
+{
+    DLDevice ret;
+
+    if (MPY_IS_HOST_DEVICE(device)) {
+        ret.device_type = kDLCPU;
+        ret.device_id = 0;
+    }
+    else {
+        ret.device_type = kDLExtDev;
+        ret.device_id = device;
+    }
+    return ret;
+}
+
+static int
+_dlpack_dtype_of(PyArray_Descr *descr, DLDataType *dtype)
+{
+    if (!PyArray_ISNBO(descr->byteorder)) {
+        PyErr_SetString(PyExc_BufferError,
+                "DLPack only supports native byte order");
+        return -1;
+    }
+
+    switch (descr->kind) {
+        case 'b':
+            dtype->code = kDLBool;
+            break;
+        case 'i':
+            dtype->code = kDLInt;
+            break;
+        case 'u':
+            dtype->code = kDLUInt;
+            break;
+        case 'f':
+            dtype->code = kDLFloat;
+            break;
+        case 'c':
+            dtype->code = kDLComplex;
+            break;
+        default:
+            PyErr_SetString(PyExc_BufferError,
+                    "DLPack only supports boolean, integer, "
+                    "floating point and complex dtypes");
+            return -1;
+    }
+    dtype->bits = (uint8_t)(descr->elsize * 8);
+    dtype->lanes = 1;
+
+    return 0;
+}
+
+static PyArray_Descr *
+_dlpack_descr_of(DLDataType dtype)
+{
+    int type_num = NPY_NOTYPE;
+
+    if (dtype.lanes != 1) {
+        PyErr_SetString(PyExc_BufferError,
+                "DLPack tensors with lanes != 1 are not supported");
+        return NULL;
+    }
+
+    switch (dtype.code) {
+        case kDLBool:
+            type_num = (dtype.bits == 8) ? NPY_BOOL : NPY_NOTYPE;
+            break;
+        case kDLInt:
+            switch (dtype.bits) {
+                case 8: type_num = NPY_INT8; break;
+                case 16: type_num = NPY_INT16; break;
+                case 32: type_num = NPY_INT32; break;
+                case 64: type_num = NPY_INT64; break;
+            }
+            break;
+        case kDLUInt:
+            switch (dtype.bits) {
+                case 8: type_num = NPY_UINT8; break;
+                case 16: type_num = NPY_UINT16; break;
+                case 32: type_num = NPY_UINT32; break;
+                case 64: type_num = NPY_UINT64; break;
+            }
+            break;
+        case kDLFloat:
+            switch (dtype.bits) {
+                case 16: type_num = NPY_FLOAT16; break;
+                case 32: type_num = NPY_FLOAT32; break;
+                case 64: type_num = NPY_FLOAT64; break;
+            }
+            break;
+        case kDLComplex:
+            switch (dtype.bits) {
+                case 64: type_num = NPY_COMPLEX64; break;
+                case 128: type_num = NPY_COMPLEX128; break;
+            }
+            break;
+    }
+
+    if (type_num == NPY_NOTYPE) {
+        PyErr_SetString(PyExc_BufferError,
+                "unsupported DLPack data type");
+        return NULL;
+    }
+    return PyArray_DescrFromType(type_num);
+}
+
+/*
+ * ndarray.__dlpack__(stream=None)
+ * Exports the array as a DLPack capsule.  If 'stream' is a micpy.Stream,
+ * transfers queued on it are waited for first.
+ */
+NPY_NO_EXPORT PyObject *
+array_dlpack(PyMicArrayObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"stream", NULL};
+    PyObject *stream = Py_None;
+    mpy_dlpack_export *export;
+    DLTensor *tensor;
+    PyObject *capsule;
+    npy_intp itemsize = PyMicArray_ITEMSIZE(self);
+    int i, ndim = PyMicArray_NDIM(self);
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O:__dlpack__", kwlist,
+                                     &stream)) {
+        return NULL;
+    }
+    if (!PyMicArray_ISWRITEABLE(self)) {
+        PyErr_SetString(PyExc_BufferError,
+                "cannot export a read-only array, DLPack can't mark "
+                "it read-only");
+        return NULL;
+    }
+    if (stream != Py_None && PyMicStream_Synchronize(stream) < 0) {
+        return NULL;
+    }
+
+    export = (mpy_dlpack_export *)malloc(sizeof(mpy_dlpack_export));
+    if (export == NULL) {
+        return PyErr_NoMemory();
+    }
+    tensor = &export->tensor.dl_tensor;
+
+    if (_dlpack_dtype_of(PyMicArray_DESCR(self), &tensor->dtype) < 0) {
+        free(export);
+        return NULL;
+    }
+    for (i = 0; i < ndim; ++i) {
+        if (PyMicArray_STRIDE(self, i) % itemsize != 0) {
+            PyErr_SetString(PyExc_BufferError,
+                    "DLPack only supports strides which are a multiple "
+                    "of the itemsize");
+            free(export);
+            return NULL;
+        }
+        export->shape[i] = PyMicArray_DIM(self, i);
+        export->strides[i] = PyMicArray_STRIDE(self, i) / itemsize;
+    }
+
+    tensor->data = PyMicArray_DATA(self);
+    tensor->device = _dlpack_device_of(PyMicArray_DEVICE(self));
+    tensor->ndim = ndim;
+    tensor->shape = export->shape;
+    tensor->strides = export->strides;
+    tensor->byte_offset = 0;
+
+    Py_INCREF(self);
+    export->tensor.manager_ctx = self;
+    export->tensor.deleter = _dlpack_deleter;
+
+    capsule = PyCapsule_New(&export->tensor, DLPACK_CAPSULE_NAME,
+                            _dlpack_capsule_destructor);
+    if (capsule == NULL) {
+        Py_DECREF(self);
+        free(export);
+        return NULL;
+    }
+
+    return capsule;
+}
+
+/* ndarray.__dlpack_device__() */
+NPY_NO_EXPORT PyObject *
+array_dlpack_device(PyMicArrayObject *self, PyObject *NPY_UNUSED(args))
+{
+    DLDevice device = _dlpack_device_of(PyMicArray_DEVICE(self));
+    return Py_BuildValue("ii", device.device_type, device.device_id);
+}
+
+/*
+ * Whether arrays imported from 'obj' may be written, the producer's own
+ * flag when it is a micpy or numpy array.
+ */
+static int
+_producer_writeable(PyObject *obj)
+{
+    if (PyMicArray_Check(obj)) {
+        return PyMicArray_ISWRITEABLE((PyMicArrayObject *)obj);
+    }
+    if (PyArray_Check(obj)) {
+        return PyArray_ISWRITEABLE((PyArrayObject *)obj);
+    }
+    return 1;
+}
+
+/*
+ * micpy.from_dlpack(obj)
+ * Wraps a DLPack tensor, or any object with __dlpack__, as a micpy
+ * array without copying.  kDLCPU tensors land on the host device and
+ * kDLExtDev tensors on the device with their id.
+ */
+NPY_NO_EXPORT PyObject *
+array_from_dlpack(PyObject *NPY_UNUSED(ignored), PyObject *obj)
+{
+    PyObject *capsule, *base;
+    DLManagedTensor *managed;
+    DLTensor *tensor;
+    PyArray_Descr *descr;
+    PyMicArrayObject *ret;
+    npy_intp dims[NPY_MAXDIMS], strides[NPY_MAXDIMS];
+    int i, device;
+
+    if (PyCapsule_CheckExact(obj)) {
+        Py_INCREF(obj);
+        capsule = obj;
+    }
+    else {
+        capsule = PyObject_CallMethod(obj, "__dlpack__", NULL);
+        if (capsule == NULL) {
+            return NULL;
+        }
+    }
+
+    managed = (DLManagedTensor *)PyCapsule_GetPointer(capsule,
+                                                      DLPACK_CAPSULE_NAME);
+    if (managed == NULL) {
+        Py_DECREF(capsule);
+        return NULL;
+    }
+    tensor = &managed->dl_tensor;
+
+    if (tensor->ndim < 0 || tensor->ndim > NPY_MAXDIMS) {
+        PyErr_Format(PyExc_BufferError,
+                "DLPack tensor has %d dimensions, at most %d are supported",
+                (int)tensor->ndim, NPY_MAXDIMS);
+        Py_DECREF(capsule);
+        return NULL;
+    }
+
+    if (tensor->device.device_type == kDLCPU) {
+        device = CPU_DEVICE;
+    }
+    else if (tensor->device.device_type == kDLExtDev &&
+             tensor->device.device_id >= 0 &&
+             tensor->device.device_id < NDEVICES) {
+        device = tensor->device.device_id;
+    }
+    else {
+        PyErr_SetString(PyExc_BufferError,
+                "DLPack tensor is not on the host or a MIC device");
+        Py_DECREF(capsule);
+        return NULL;
+    }
+
+    descr = _dlpack_descr_of(tensor->dtype);
+    if (descr == NULL) {
+        Py_DECREF(capsule);
+        return NULL;
+    }
+
+    for (i = 0; i < tensor->ndim; ++i) {
+        dims[i] = (npy_intp)tensor->shape[i];
+        if (tensor->strides != NULL) {
+            strides[i] = (npy_intp)tensor->strides[i] * descr->elsize;
+        }
+    }
+
+    ret = (PyMicArrayObject *)PyMicArray_NewFromDescr(device,
+                    &PyMicArray_Type, descr, tensor->ndim, dims,
+                    (tensor->strides != NULL) ? strides : NULL,
+                    (char *)tensor->data + tensor->byte_offset,
+                    _producer_writeable(obj) ? NPY_ARRAY_WRITEABLE : 0,
+                    NULL);
+    if (ret == NULL) {
+        Py_DECREF(capsule);
+        return NULL;
+    }
+
+    /* The new array owns the tensor from now on */
+    base = PyCapsule_New(managed, DLPACK_USED_CAPSULE_NAME,
+                         _dlpack_used_capsule_destructor);
+    if (base == NULL) {
+        Py_DECREF(ret);
+        Py_DECREF(capsule);
+        return NULL;
+    }
+    if (PyMicArray_SetBaseObject(ret, base) < 0) {
+        /* The base capsule was released with the tensor */
+        PyCapsule_SetName(capsule, DLPACK_USED_CAPSULE_NAME);
+        Py_DECREF(ret);
+        Py_DECREF(capsule);
+        return NULL;
+    }
+    if (PyCapsule_SetName(capsule, DLPACK_USED_CAPSULE_NAME) < 0) {
+        Py_DECREF(ret);
+        Py_DECREF(capsule);
+        return NULL;
+    }
+    Py_DECREF(capsule);
+
+    return (PyObject *)ret;
+}
@@ -0,0 +1,15 @@
+#ifndef _MPY_DLPACK_H_
+#define _MPY_DLPACK_H_
+
+#include "arrayobject.h"
+
+NPY_NO_EXPORT PyObject *
+array_dlpack(PyMicArrayObject *self, PyObject *args, PyObject *kwds);
+
+NPY_NO_EXPORT PyObject *
+array_dlpack_device(PyMicArrayObject *self, PyObject *NPY_UNUSED(args));
+
+NPY_NO_EXPORT PyObject *
+array_from_dlpack(PyObject *NPY_UNUSED(ignored), PyObject *obj);
+
+#endif
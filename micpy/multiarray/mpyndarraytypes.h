@@ -10,6 +10,9 @@
 
 typedef int (PyMicArray_CompareFunc)(const void *, const void *, void *);
 typedef int (PyMicArray_ArgFunc)(void*, npy_intp, npy_intp*, int);
+typedef int (PyMicArray_StridedArgFunc)(void *, npy_intp, npy_intp, int,
+                                       npy_intp *, npy_intp *, npy_intp *,
+                                       int);
 
 typedef void (PyMicArray_DotFunc)(void *, npy_intp, void *, npy_intp, void *,
                                   npy_intp, int);
@@ -136,6 +139,15 @@ typedef struct {
          */
         PyMicArray_ArgFunc *argmin;
 
+        /*
+         * argmax/argmin of every row of a strided array, the reduced
+         * axis given by length and stride, the others by shape and
+         * strides.
+         * Can be NULL
+         */
+        PyMicArray_StridedArgFunc *stridedargmax;
+        PyMicArray_StridedArgFunc *stridedargmin;
+
 } PyMicArray_ArrFuncs;
 
 #define PyMicArray_ISBOOL(obj) PyTypeNum_ISBOOL(PyMicArray_TYPE(obj))
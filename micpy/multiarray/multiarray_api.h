@@ -253,4 +253,16 @@ static int _import_pymicarray() {
 #define PyMicArray_OutputConverter \
     ((int (*)(PyObject *, PyMicArrayObject **)) \
      PyMicArray_API[58])
+#define MpyIter_GetOffIter \
+    (*(MpyIter * (*)(MpyIter *)) \
+     PyMicArray_API[59])
+#define MpyIter_CanOffloadIternext \
+    (*(npy_bool (*)(MpyIter_IterNextFunc *)) \
+     PyMicArray_API[60])
+#define PyMicStream_Synchronize \
+    (*(int (*)(PyObject *)) \
+     PyMicArray_API[61])
+#define PyMicStream_Fence \
+    (*(void (*)(PyObject *, int)) \
+     PyMicArray_API[62])
 #endif
@@ -69,6 +69,10 @@
         (void *) &PyMicArray_SetBaseObject,\
         (void *) &PyMicArray_SetUpdateIfCopyBase,\
         (void *) &PyMicArray_OutputConverter,\
+        (void *) &MpyIter_GetOffIter,\
+        (void *) &MpyIter_CanOffloadIternext,\
+        (void *) &PyMicStream_Synchronize,\
+        (void *) &PyMicStream_Fence,\
         NULL\
     }
 
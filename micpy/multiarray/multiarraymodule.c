@@ -50,6 +50,9 @@
 #include "cblasfuncs.h"
 #include "mpymem_overlap.h"
 #include "convert_datatype.h"
+#include "mempool.h"
+#include "stream.h"
+#include "mpy_dlpack.h"
 
 static int num_devices;
 static int current_device;
@@ -78,11 +81,15 @@ get_current_device(PyObject *NPY_UNUSED(ignored), PyObject *args){
 static PyObject *
 set_current_device(PyObject *NPY_UNUSED(ignored), PyObject *device_id)
 {
-    int device = -1;
+    int device = MPY_NO_DEVICE;
 
     if (!PyMicArray_DeviceConverter(device_id, &device)) {
         return NULL;
     }
+    if (device == MPY_NO_DEVICE) {
+        PyErr_SetString(PyExc_TypeError, "device must be an integer");
+        return NULL;
+    }
 
     current_device = device;
     Py_RETURN_NONE;
@@ -1110,23 +1117,97 @@ array_fastCopyAndTranspose(PyObject *NPY_UNUSED(dummy), PyObject *args)
 
 
 static PyObject *
-array_tohost(PyObject *NPY_UNUSED(ignored), PyObject *args)
+array_tohost(PyObject *NPY_UNUSED(ignored), PyObject *args, PyObject *kwds)
 {
+    static char *kwlist[] = {"arr","stream","out","alias",NULL};
     PyObject *array = NULL;
+    PyObject *stream = Py_None;
+    PyObject *out = Py_None;
+    npy_bool alias = NPY_FALSE;
     PyArrayObject *ret = NULL;
 
-    if (!PyArg_ParseTuple(args, "O&",
-                &PyMicArray_GeneralConverter, &array)) {
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&|OOO&", kwlist,
+                &PyMicArray_GeneralConverter, &array,
+                &stream, &out,
+                &PyArray_BoolConverter, &alias)) {
         goto fail;
     }
 
+    if (out != Py_None) {
+        if (!PyArray_Check(out)) {
+            PyErr_SetString(PyExc_TypeError,
+                    "out must be a numpy.ndarray");
+            goto fail;
+        }
+        if (check_out_shape(PyArray_NDIM((PyArrayObject *)array),
+                            PyArray_DIMS((PyArrayObject *)array),
+                            PyArray_NDIM((PyArrayObject *)out),
+                            PyArray_DIMS((PyArrayObject *)out)) < 0) {
+            goto fail;
+        }
+    }
+
+    if (stream != Py_None) {
+        PyObject *transfer;
+
+        if (!PyMicStream_Check(stream)) {
+            PyErr_SetString(PyExc_TypeError, "stream must be a micpy.Stream");
+            goto fail;
+        }
+        if (!PyMicArray_Check(array)) {
+            PyErr_SetString(PyExc_TypeError,
+                    "to_cpu on a stream needs a micpy.ndarray");
+            goto fail;
+        }
+        transfer = PyMicStream_ToHost((PyMicStreamObject *)stream,
+                        (PyMicArrayObject *)array,
+                        (out != Py_None) ? (PyArrayObject *)out : NULL);
+        Py_DECREF(array);
+        return transfer;
+    }
+
+    /* Transfers in flight may still be writing the source */
+    PyMicStream_Fence(array, 0);
+
+    if (out != Py_None) {
+        int copy_ret;
+
+        PyMicStream_Fence(out, 1);
+
+        if (PyArray_Check(array)) {
+            copy_ret = PyArray_CopyInto((PyArrayObject *)out,
+                                        (PyArrayObject *)array);
+        }
+        else {
+            copy_ret = PyMicArray_CopyIntoHost((PyArrayObject *)out,
+                                               (PyMicArrayObject *)array);
+        }
+        if (copy_ret < 0) {
+            goto fail;
+        }
+        Py_DECREF(array);
+        Py_INCREF(out);
+        return out;
+    }
+
     /* If array is numpy ndarray, return itself */
     if (PyArray_Check(array)) {
         return array;
     }
 
-    ret = (PyArrayObject *) PyArray_NewLikeArray((PyArrayObject *) array,
-                                            NPY_KEEPORDER, NULL, 0);
+    /* Host-device mode, share the buffer if asked to */
+    if (alias && MPY_IS_HOST_DEVICE(PyMicArray_DEVICE(array))) {
+        ret = (PyArrayObject *)PyMicArray_HostView(
+                                    (PyMicArrayObject *)array);
+        Py_DECREF(array);
+        return (PyObject *)ret;
+    }
+
+    /* Device results land in a pinned buffer, one transfer at full speed */
+    ret = mpy_pinned_like((PyArrayObject *) array, NULL);
+    if (ret == NULL) {
+        goto fail;
+    }
     if (PyMicArray_CopyIntoHost(ret, (PyMicArrayObject * ) array) < 0){
         Py_XDECREF(ret);
         goto fail;
@@ -1144,17 +1225,73 @@ fail:
 static PyObject *
 array_todevice(PyObject *NPY_UNUSED(ignored), PyObject *args, PyObject *kwds)
 {
-    static char *kwlist[] = {"arr","device",NULL};
+    static char *kwlist[] = {"arr","device","stream","out","alias",NULL};
     PyArrayObject *array = NULL;
     PyMicArrayObject *ret = NULL;
-    int device = DEFAULT_DEVICE;
+    PyMicArrayObject *out = NULL;
+    PyObject *stream = Py_None;
+    npy_bool alias = NPY_FALSE;
+    int device = MPY_NO_DEVICE;
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&|O&", kwlist,
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&|O&OO&O&", kwlist,
                 &PyArray_Converter, &array,
-                &PyMicArray_DeviceConverter, &device)) {
+                &PyMicArray_DeviceConverter, &device,
+                &stream,
+                &PyMicArray_OutputConverter, &out,
+                &PyArray_BoolConverter, &alias)) {
         goto fail;
     }
 
+    if (out != NULL) {
+        if (device != MPY_NO_DEVICE && device != PyMicArray_DEVICE(out)) {
+            PyErr_Format(PyExc_ValueError,
+                    "out array is on device %d, not on device %d",
+                    PyMicArray_DEVICE(out), device);
+            goto fail;
+        }
+        device = PyMicArray_DEVICE(out);
+        if (check_out_shape(PyArray_NDIM(array), PyArray_DIMS(array),
+                            PyMicArray_NDIM(out), PyMicArray_DIMS(out)) < 0) {
+            goto fail;
+        }
+    }
+    else if (device == MPY_NO_DEVICE) {
+        device = DEFAULT_DEVICE;
+    }
+
+    if (stream != Py_None) {
+        PyObject *transfer;
+
+        if (!PyMicStream_Check(stream)) {
+            PyErr_SetString(PyExc_TypeError, "stream must be a micpy.Stream");
+            goto fail;
+        }
+        transfer = PyMicStream_ToDevice((PyMicStreamObject *)stream,
+                                        array, device, out);
+        Py_DECREF(array);
+        return transfer;
+    }
+
+    /* Transfers in flight may still be writing the source */
+    PyMicStream_Fence((PyObject *)array, 0);
+
+    if (out != NULL) {
+        PyMicStream_Fence((PyObject *)out, 1);
+        if (PyMicArray_CopyIntoFromHost(out, array) < 0) {
+            goto fail;
+        }
+        Py_DECREF(array);
+        Py_INCREF(out);
+        return (PyObject *)out;
+    }
+
+    /* Host-device mode, share the buffer if asked to */
+    if (alias && MPY_IS_HOST_DEVICE(device)) {
+        ret = (PyMicArrayObject *)PyMicArray_AliasHostArray(array, device);
+        Py_DECREF(array);
+        return (PyObject *)ret;
+    }
+
     ret = (PyMicArrayObject *)PyMicArray_NewLikeArray(device, array,
                                             NPY_KEEPORDER, NULL, 0);
     if (PyMicArray_CopyIntoFromHost(ret, array) < 0){
@@ -1171,6 +1308,26 @@ fail:
 }
 
 
+/*
+ * micpy.device_copy_stats()
+ * Size, duration and bandwidth (bytes per second) of the last copy
+ * between two devices.
+ */
+static PyObject *
+array_device_copy_stats(PyObject *NPY_UNUSED(ignored),
+                        PyObject *NPY_UNUSED(args))
+{
+    npy_intp nbytes;
+    double seconds;
+
+    mpy_get_peer_copy_stats(&nbytes, &seconds);
+    return Py_BuildValue("{s:n,s:d,s:d}",
+                         "bytes", (Py_ssize_t)nbytes,
+                         "seconds", seconds,
+                         "bandwidth", (seconds > 0) ? nbytes / seconds : 0.0);
+}
+
+
 static PyObject *
 format_longfloat(PyObject *NPY_UNUSED(dummy), PyObject *args, PyObject *kwds)
 {
@@ -1303,7 +1460,7 @@ static struct PyMethodDef array_module_methods[] = {
         METH_VARARGS, NULL},*/
     {"to_cpu",
         (PyCFunction)array_tohost,
-        METH_VARARGS, NULL},
+        METH_VARARGS | METH_KEYWORDS, NULL},
     {"to_mic",
         (PyCFunction)array_todevice,
         METH_VARARGS | METH_KEYWORDS, NULL},
@@ -1313,6 +1470,18 @@ static struct PyMethodDef array_module_methods[] = {
     {"set_device",
         (PyCFunction)set_current_device,
         METH_O, NULL},
+    {"memory_pool",
+        (PyCFunction)array_memory_pool,
+        METH_VARARGS | METH_KEYWORDS, NULL},
+    {"empty_pinned",
+        (PyCFunction)array_empty_pinned,
+        METH_VARARGS | METH_KEYWORDS, NULL},
+    {"device_copy_stats",
+        (PyCFunction)array_device_copy_stats,
+        METH_NOARGS, NULL},
+    {"from_dlpack",
+        (PyCFunction)array_from_dlpack,
+        METH_O, NULL},
     {NULL, NULL, 0, NULL}                /* sentinel */
 };
 
@@ -1376,6 +1545,10 @@ PyMODINIT_FUNC initmultiarray(void) {
     /* Init some variable */
     num_devices = omp_get_num_devices();
     current_device = omp_get_default_device();
+    /* Without offload devices run in host-device mode */
+    if (num_devices == 0) {
+        current_device = omp_get_initial_device();
+    }
 
     /* Create the module and add the functions */
 #if defined(NPY_PY3K)
@@ -1415,6 +1588,15 @@ PyMODINIT_FUNC initmultiarray(void) {
     if (PyType_Ready(&PyMicArray_Type) < 0) {
         return RETVAL;
     }
+    if (PyType_Ready(&PyMicMemoryPool_Type) < 0) {
+        return RETVAL;
+    }
+    if (PyType_Ready(&PyMicStream_Type) < 0) {
+        return RETVAL;
+    }
+    if (PyType_Ready(&PyMicTransfer_Type) < 0) {
+        return RETVAL;
+    }
 
     /*
      * PyExc_Exception should catch all the standard errors that are
@@ -1464,6 +1646,9 @@ PyMODINIT_FUNC initmultiarray(void) {
 
     //Py_INCREF(&PyMicArray_Type);
     PyDict_SetItemString(d, "ndarray", (PyObject *)&PyMicArray_Type);
+    PyDict_SetItemString(d, "MemoryPool", (PyObject *)&PyMicMemoryPool_Type);
+    PyDict_SetItemString(d, "Stream", (PyObject *)&PyMicStream_Type);
+    PyDict_SetItemString(d, "Transfer", (PyObject *)&PyMicTransfer_Type);
 
     /* Add some other constants */
     obj_ndevices = (PyObject *) PyInt_FromLong(num_devices);
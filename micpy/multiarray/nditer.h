@@ -163,6 +163,12 @@ MpyIter_GetOffInnerLoopSizePtr(MpyIter *iter);
 NPY_NO_EXPORT int
 MpyIter_GetDevice(MpyIter *iter);
 
+NPY_NO_EXPORT MpyIter *
+MpyIter_GetOffIter(MpyIter *iter);
+
+NPY_NO_EXPORT npy_bool
+MpyIter_CanOffloadIternext(MpyIter_IterNextFunc *iternext);
+
 NPY_NO_EXPORT void
 MpyIter_DebugPrint(MpyIter *iter);
 
@@ -890,6 +890,19 @@ MpyIter_GetDevice(MpyIter *iter)
     return NIT_DEVICE(iter);
 }
 
+/*NUMPY_API
+ * Gets the device address of the mirrored iterator.
+ * Changes made on the host since the last call are sent first, so an
+ * offloadable iternext (see MpyIter_CanOffloadIternext) can drive
+ * the whole iteration from inside a single target region.
+ */
+NPY_NO_EXPORT MpyIter *
+MpyIter_GetOffIter(MpyIter *iter)
+{
+    mpyiter_sync_offiter(iter);
+    return (MpyIter *) NIT_OFFITER(iter);
+}
+
 /*NUMPY_API
  * Whether the iterator is buffered
  */
@@ -1089,6 +1102,8 @@ MpyIter_GetOffDataPtrArray(MpyIter *iter)
     int nop = NIT_NOP(iter);
     MpyIter *offiter = (MpyIter *) NIT_OFFITER(iter);
 
+    mpyiter_sync_offiter(iter);
+
     if (itflags&NPY_ITFLAG_BUFFER) {
         NpyIter_BufferData *bufferdata = NIT_BUFFERDATA(offiter);
         return (npy_intp *)NBF_PTRS(bufferdata);
@@ -1129,6 +1144,8 @@ MpyIter_GetOffInitialDataPtrArray(MpyIter *iter)
     int nop = NIT_NOP(iter);
     MpyIter *offiter = (MpyIter *) NIT_OFFITER(iter);
 
+    mpyiter_sync_offiter(iter);
+
     return (npy_intp *)NIT_RESETDATAPTR(offiter);
 }
 
@@ -1255,6 +1272,8 @@ MpyIter_GetOffIndexPtr(MpyIter *iter)
     int nop = NIT_NOP(iter);
     MpyIter *offiter = (MpyIter *) NIT_OFFITER(iter);
 
+    mpyiter_sync_offiter(iter);
+
     NpyIter_AxisData *axisdata = NIT_AXISDATA(offiter);
 
     if (itflags&NPY_ITFLAG_HASINDEX) {
@@ -1332,6 +1351,8 @@ MpyIter_GetOffInnerStrideArray(MpyIter *iter)
     int nop = NIT_NOP(iter);
     MpyIter *offiter = (MpyIter *) NIT_OFFITER(iter);
 
+    mpyiter_sync_offiter(iter);
+
     if (itflags&NPY_ITFLAG_BUFFER) {
         NpyIter_BufferData *data = NIT_BUFFERDATA(offiter);
         return NBF_STRIDES(data);
@@ -1398,6 +1419,7 @@ MpyIter_GetAxisStrideArray(MpyIter *iter, int axis)
 NPY_NO_EXPORT npy_intp *
 MpyIter_GetOffAxisStrideArray(MpyIter *iter, int axis)
 {
+    mpyiter_sync_offiter(iter);
     return getAxisStrideArray(iter, axis, 1);
 }
 
@@ -1517,6 +1539,8 @@ MpyIter_GetOffInnerLoopSizePtr(MpyIter *iter)
     int nop = NIT_NOP(iter);
     MpyIter *offiter = (MpyIter *) NIT_OFFITER(iter);
 
+    mpyiter_sync_offiter(iter);
+
     if (itflags&NPY_ITFLAG_BUFFER) {
         NpyIter_BufferData *data = NIT_BUFFERDATA(offiter);
         return &NBF_SIZE(data);
@@ -2941,57 +2965,39 @@ npyiter_checkreducesize(MpyIter *iter, npy_intp count,
     return count * (*reduce_innersize);
 }
 
-/* This is called when an iter is updated in host.
- * This function transfer to iter data to corresponding
- * iter on mic device
+/*
+ * Called whenever the host iterator changes.  Nothing is sent yet, the
+ * device copy is only refreshed by mpyiter_sync_offiter once somebody
+ * asks for a device address.  Resets, gotos and buffer refills between
+ * two offloads thus cost a single transfer of the whole iterator, and
+ * iterators that are only driven from the host never transfer at all.
  */
 NPY_NO_EXPORT void mpyiter_update_offiter(MpyIter *iter)
 {
-    npy_uint32 itflags = NIT_ITFLAGS(iter);
-    int ndim = NIT_NDIM(iter);
-    int nop = NIT_NOP(iter);
-    void *offiter = (void *) NIT_OFFITER(iter);
-
-    target_memcpy(offiter, (void *)iter,
-                        NIT_SIZEOF_ITERATOR(itflags, ndim, nop),
-                        NIT_DEVICE(iter), CPU_DEVICE);
+    NIT_OFFDIRTY(iter) = 1;
 }
 
-/* This function is called when iter's bufferdata is
- * updated in host.
- * Initially intended to used in internext functions
- */
-NPY_NO_EXPORT void mpyiter_update_offbuffdata(MpyIter *iter)
+/* Sends the host iterator, axis and buffer data included, in one copy */
+NPY_NO_EXPORT void mpyiter_sync_offiter(MpyIter *iter)
 {
     npy_uint32 itflags = NIT_ITFLAGS(iter);
     int ndim = NIT_NDIM(iter);
     int nop = NIT_NOP(iter);
-    MpyIter *offiter = NIT_OFFITER(iter);
 
-    target_memcpy(NIT_BUFFERDATA(offiter), NIT_BUFFERDATA(iter),
-                        NIT_BUFFERDATA_SIZEOF(itflags, ndim, nop),
-                        NIT_DEVICE(iter), CPU_DEVICE);
-}
-
-/* This function is called when iter's axisdata is
- * updated in host.
- * Initially intended to used in internext functions.
- */
-NPY_NO_EXPORT void mpyiter_update_offaxisdata(MpyIter *iter)
-{
-    npy_uint32 itflags = NIT_ITFLAGS(iter);
-    int ndim = NIT_NDIM(iter);
-    int nop = NIT_NOP(iter);
-    MpyIter *offiter = NIT_OFFITER(iter);
+    if (!NIT_OFFDIRTY(iter)) {
+        return;
+    }
+    NIT_OFFDIRTY(iter) = 0;
 
-    target_memcpy(NIT_AXISDATA(offiter), NIT_AXISDATA(iter),
-                        NIT_AXISDATA_SIZEOF(itflags, ndim, nop)*(ndim ? ndim : 1),
+    target_memcpy(NIT_OFFITER(iter), (void *)iter,
+                        NIT_SIZEOF_ITERATOR(itflags, ndim, nop),
                         NIT_DEVICE(iter), CPU_DEVICE);
 }
 
 NPY_NO_EXPORT void MpyIter_UpdateOffIter(MpyIter *iter)
 {
     mpyiter_update_offiter(iter);
+    mpyiter_sync_offiter(iter);
 }
 
 static void dummyOffloadBuild(void)
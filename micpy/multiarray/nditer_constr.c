@@ -224,8 +224,13 @@ MpyIter_AdvancedNew(int nop, PyMicArrayObject **op_in, npy_uint32 flags,
                 PyObject_Malloc(NIT_SIZEOF_ITERATOR(itflags, ndim, nop));
 
     /* Allocate on mic device */
-    offiter = omp_target_alloc(
+    offiter = mpyiter_offiter_alloc(
                     NIT_SIZEOF_ITERATOR(itflags, ndim, nop), device);
+    if (offiter == NULL) {
+        PyObject_Free(iter);
+        PyErr_NoMemory();
+        return NULL;
+    }
 
     NPY_IT_TIME_POINT(c_malloc);
 
@@ -235,6 +240,7 @@ MpyIter_AdvancedNew(int nop, PyMicArrayObject **op_in, npy_uint32 flags,
     NIT_NOP(iter) = nop;
     NIT_DEVICE(iter) = device;
     NIT_OFFITER(iter) = offiter;
+    NIT_OFFDIRTY(iter) = 1;
     NIT_MASKOP(iter) = -1;
     NIT_ITERINDEX(iter) = 0;
     memset(NIT_BASEOFFSETS(iter), 0, (nop+1)*NPY_SIZEOF_INTP);
@@ -250,7 +256,8 @@ MpyIter_AdvancedNew(int nop, PyMicArrayObject **op_in, npy_uint32 flags,
                         flags,
                         op_flags, op_itflags,
                         &NIT_MASKOP(iter))) {
-        omp_target_free((void *) offiter, device);
+        mpyiter_offiter_free(offiter,
+                    NIT_SIZEOF_ITERATOR(itflags, ndim, nop), device);
         PyObject_Free(iter);
         return NULL;
     }
@@ -596,11 +603,22 @@ MpyIter_Copy(MpyIter *iter)
     /* Allocate memory for the new iterator */
     size = NIT_SIZEOF_ITERATOR(itflags, ndim, nop);
     newiter = (MpyIter*)PyObject_Malloc(size);
-    //TODO: alocate on mic device
+    if (newiter == NULL) {
+        PyErr_NoMemory();
+        return NULL;
+    }
 
     /* Copy the raw values to the new iterator */
     memcpy(newiter, iter, size);
 
+    /* The copy needs its own device iterator */
+    NIT_OFFITER(newiter) = mpyiter_offiter_alloc(size, device);
+    if (NIT_OFFITER(newiter) == NULL) {
+        PyObject_Free(newiter);
+        PyErr_NoMemory();
+        return NULL;
+    }
+
     /* Take ownership of references to the operands and dtypes */
     objects = NIT_OPERANDS(newiter);
     dtypes = NIT_DTYPES(newiter);
@@ -738,8 +756,9 @@ MpyIter_Deallocate(MpyIter *iter)
         Py_XDECREF(*object);
     }
 
-    /* Deallocate device memory */
-    target_free(NIT_OFFITER(iter), device);
+    /* Give the device iterator back to the cache */
+    mpyiter_offiter_free(NIT_OFFITER(iter),
+                    NIT_SIZEOF_ITERATOR(itflags, NIT_NDIM(iter), nop), device);
 
     /* Deallocate the iterator memory */
     PyObject_Free(iter);
@@ -747,6 +766,79 @@ MpyIter_Deallocate(MpyIter *iter)
     return NPY_SUCCEED;
 }
 
+/*
+ * Device copies of the iterators are cached per device and handed out
+ * again to iterators of the same byte size, which is a function of
+ * (itflags, ndim, nop) only.  Most calls build the same few layouts,
+ * so in steady state no omp_target_alloc/omp_target_free is left on
+ * the iterator construction path.
+ *
+ * RemoveAxis and coalescing may shrink ndim after allocation, so a block
+ * can be returned under a smaller size than it has.  That is harmless,
+ * it is simply reused for the smaller layout.
+ *
+ * As the rest of the allocation cache, this assumes the GIL is held.
+ */
+#define MPY_OFFITER_NCACHE 16
+
+typedef struct {
+    npy_intp size;
+    void *ptr;
+} mpy_offiter_block;
+
+static mpy_offiter_block offiter_cache[NMAXDEVICES][MPY_OFFITER_NCACHE];
+static int offiter_cache_count[NMAXDEVICES];
+
+NPY_NO_EXPORT void *
+mpyiter_offiter_alloc(npy_intp size, int device)
+{
+    mpy_offiter_block *cache;
+    int i, n;
+
+    if (device >= 0 && device < NMAXDEVICES) {
+        cache = offiter_cache[device];
+        n = offiter_cache_count[device];
+        /* Most recently freed first, it is the likeliest match */
+        for (i = n - 1; i >= 0; --i) {
+            if (cache[i].size == size) {
+                void *ptr = cache[i].ptr;
+                cache[i] = cache[n - 1];
+                offiter_cache_count[device] = n - 1;
+                return ptr;
+            }
+        }
+    }
+
+    return target_alloc(size, device);
+}
+
+NPY_NO_EXPORT void
+mpyiter_offiter_free(void *offiter, npy_intp size, int device)
+{
+    int n;
+
+    if (offiter == NULL) {
+        return;
+    }
+
+    if (device >= 0 && device < NMAXDEVICES) {
+        n = offiter_cache_count[device];
+        if (n == MPY_OFFITER_NCACHE) {
+            /* Evict the oldest entry */
+            target_free(offiter_cache[device][0].ptr, device);
+            memmove(&offiter_cache[device][0], &offiter_cache[device][1],
+                    (n - 1) * sizeof(mpy_offiter_block));
+            --n;
+        }
+        offiter_cache[device][n].size = size;
+        offiter_cache[device][n].ptr = offiter;
+        offiter_cache_count[device] = n + 1;
+        return;
+    }
+
+    target_free(offiter, device);
+}
+
 /* Get common device from PyMicArrayObjects
  *
  * Retunrs 1 on success, 0 on error
@@ -145,6 +145,8 @@ struct MpyIter_InternalOnly {
     int device;
     void *offptr;
     npy_int8 maskop;
+    /* Set when offptr lags behind the host iterator */
+    npy_int8 offdirty;
     npy_intp itersize, iterstart, iterend;
     /* iterindex is only used if RANGED or BUFFERED is set */
     npy_intp iterindex;
@@ -211,6 +213,8 @@ typedef npy_int16 npyiter_opitflags;
         ((iter)->offptr)
 #define NIT_MASKOP(iter) \
         ((iter)->maskop)
+#define NIT_OFFDIRTY(iter) \
+        ((iter)->offdirty)
 #define NIT_ITERSIZE(iter) \
         (iter->itersize)
 #define NIT_ITERSTART(iter) \
@@ -322,6 +326,12 @@ NPY_NO_EXPORT void
 mpyiter_copy_to_buffers(MpyIter *iter, char **prev_dataptrs);
 NPY_NO_EXPORT void
 mpyiter_update_offiter(MpyIter *iter);
+NPY_NO_EXPORT void
+mpyiter_sync_offiter(MpyIter *iter);
+NPY_NO_EXPORT void *
+mpyiter_offiter_alloc(npy_intp size, int device);
+NPY_NO_EXPORT void
+mpyiter_offiter_free(void *offiter, npy_intp size, int device);
 
 
 #endif
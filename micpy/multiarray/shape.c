@@ -120,7 +120,7 @@ PyMicArray_Resize(PyMicArrayObject *self, PyArray_Dims *newshape, int refcheck,
             sd = newsize*PyMicArray_DESCR(self)->elsize;
         }
         /* Reallocate space if needed */
-        new_data = PyDataMemMic_RENEW(PyMicArray_DATA(self), sd,
+        new_data = mpy_realloc_cache(PyMicArray_DATA(self), sd,
                                         PyMicArray_DEVICE(self));
         if (new_data == NULL) {
             PyErr_SetString(PyExc_MemoryError,
@@ -0,0 +1,738 @@
+/*
+ * Asynchronous host <-> device transfers.
+ *
+ * Every stream has a worker thread, started with its first transfer,
+ * that runs the copies queued on the stream in issue order with
+ * omp_target_memcpy, straight between the host buffer and the device
+ * array.  The caller keeps computing meanwhile, and transfers on
+ * different streams overlap each other.  Copies are numbered per stream,
+ * waiting for a transfer is waiting until the stream has finished its
+ * number, with the GIL released.
+ *
+ * Only one-segment layouts are sent asynchronously.  Other layouts are
+ * first made contiguous on the side that owns them.
+ *
+ * A buffer written by a pending transfer, or read by one, must not be
+ * touched before it is done.  PyMicStream_Fence waits for the transfers
+ * an operand conflicts with, the ufunc machinery calls it on every
+ * operand and transfers call it on their own buffers.
+ */
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include "structmember.h"
+
+#define NPY_NO_DEPRECATED_API NPY_API_VERSION
+#define NO_IMPORT_ARRAY
+#define PY_ARRAY_UNIQUE_SYMBOL MICPY_ARRAY_API
+#include <numpy/arrayobject.h>
+#include <numpy/npy_3kcompat.h>
+
+#define _MICARRAYMODULE
+#include "common.h"
+#include "arrayobject.h"
+#include "creators.h"
+#include "convert.h"
+#include "mpymem_overlap.h"
+#include "stream.h"
+#include "mempool.h"
+
+/* A copy queued on a stream */
+struct _mpy_stream_job {
+    char *dst, *src;
+    int dst_device, src_device;
+    npy_intp nbytes;
+    npy_intp seq;
+    /* done field of the Transfer, alive until the copy is finished */
+    int *done;
+    mpy_stream_job *next;
+};
+
+/* Every live stream, for the fences.  Changed with the GIL held. */
+static PyMicStreamObject *live_streams = NULL;
+
+static void *
+_stream_worker(void *arg)
+{
+    PyMicStreamObject *stream = (PyMicStreamObject *)arg;
+    mpy_stream_job *job;
+    int status;
+
+    pthread_mutex_lock(&stream->lock);
+    for (;;) {
+        while (stream->head == NULL && !stream->closing) {
+            pthread_cond_wait(&stream->cond, &stream->lock);
+        }
+        if (stream->head == NULL) {
+            break;
+        }
+        /* The job stays queued while it runs, the fences see it */
+        job = stream->head;
+        pthread_mutex_unlock(&stream->lock);
+
+        status = (target_memcpy(job->dst, job->src, job->nbytes,
+                                job->dst_device, job->src_device) == 0) ?
+                 1 : -1;
+
+        pthread_mutex_lock(&stream->lock);
+        *job->done = status;
+        stream->finished = job->seq;
+        stream->head = job->next;
+        if (stream->head == NULL) {
+            stream->tail = NULL;
+        }
+        free(job);
+        pthread_cond_broadcast(&stream->cond);
+    }
+    pthread_mutex_unlock(&stream->lock);
+    return NULL;
+}
+
+/*
+ * Queue the copy of 'nbytes' bytes at 'src' on 'src_device' to 'dst' on
+ * 'dst_device' behind the earlier transfers of the stream.  The host
+ * buffer is read or written by the worker, so it must not be touched
+ * before the transfer is done.  Without a worker the copy is done here,
+ * after the queued ones.
+ */
+static void
+_stream_copy(PyMicStreamObject *stream, char *dst, int dst_device,
+             char *src, int src_device, npy_intp nbytes,
+             PyMicTransferObject *transfer)
+{
+    mpy_stream_job *job = malloc(sizeof(mpy_stream_job));
+    NPY_BEGIN_THREADS_DEF;
+
+    NPY_BEGIN_THREADS;
+    pthread_mutex_lock(&stream->lock);
+    if (job != NULL && !stream->has_worker) {
+        stream->has_worker = (pthread_create(&stream->worker, NULL,
+                                             _stream_worker, stream) == 0);
+    }
+    if (job == NULL || !stream->has_worker) {
+        while (stream->head != NULL) {
+            pthread_cond_wait(&stream->cond, &stream->lock);
+        }
+        pthread_mutex_unlock(&stream->lock);
+        free(job);
+        transfer->done = (target_memcpy(dst, src, nbytes,
+                                        dst_device, src_device) == 0) ? 1 : -1;
+    }
+    else {
+        job->dst = dst;
+        job->dst_device = dst_device;
+        job->src = src;
+        job->src_device = src_device;
+        job->nbytes = nbytes;
+        job->done = &transfer->done;
+        job->next = NULL;
+        job->seq = transfer->seq = ++stream->issued;
+        if (stream->tail != NULL) {
+            stream->tail->next = job;
+        }
+        else {
+            stream->head = job;
+        }
+        stream->tail = job;
+        pthread_cond_broadcast(&stream->cond);
+        pthread_mutex_unlock(&stream->lock);
+    }
+    NPY_END_THREADS;
+}
+
+/* Blocks until the copies of 'stream' up to number 'seq' are finished */
+static void
+_stream_wait_seq(PyMicStreamObject *stream, npy_intp seq)
+{
+    NPY_BEGIN_THREADS_DEF;
+
+    pthread_mutex_lock(&stream->lock);
+    if (stream->finished >= seq) {
+        pthread_mutex_unlock(&stream->lock);
+        return;
+    }
+    pthread_mutex_unlock(&stream->lock);
+
+    NPY_BEGIN_THREADS;
+    pthread_mutex_lock(&stream->lock);
+    while (stream->finished < seq) {
+        pthread_cond_wait(&stream->cond, &stream->lock);
+    }
+    pthread_mutex_unlock(&stream->lock);
+    NPY_END_THREADS;
+}
+
+/* Blocks until the transfers issued on 'stream' have completed */
+static void
+_stream_wait(PyMicStreamObject *stream)
+{
+    npy_intp seq;
+
+    pthread_mutex_lock(&stream->lock);
+    seq = stream->issued;
+    pthread_mutex_unlock(&stream->lock);
+    _stream_wait_seq(stream, seq);
+}
+
+/* 0 while in flight, 1 once the copy has landed, -1 if it failed */
+static int
+_transfer_status(PyMicTransferObject *self)
+{
+    int status;
+
+    pthread_mutex_lock(&self->stream->lock);
+    status = self->done;
+    pthread_mutex_unlock(&self->stream->lock);
+    return status;
+}
+
+static int
+_transfer_wait(PyMicTransferObject *self)
+{
+    _stream_wait_seq(self->stream, self->seq);
+    if (_transfer_status(self) < 0) {
+        PyErr_SetString(PyExc_RuntimeError,
+                        "failed to transfer array data between devices");
+        return -1;
+    }
+    return 0;
+}
+
+static PyMicTransferObject *
+_transfer_new(PyMicStreamObject *stream, PyObject *result, PyObject *source)
+{
+    PyMicTransferObject *ret;
+
+    ret = PyObject_New(PyMicTransferObject, &PyMicTransfer_Type);
+    if (ret == NULL) {
+        return NULL;
+    }
+    ret->done = 0;
+    ret->seq = 0;
+    Py_INCREF(stream);
+    ret->stream = stream;
+    Py_INCREF(result);
+    ret->result = result;
+    Py_XINCREF(source);
+    ret->source = source;
+
+    return ret;
+}
+
+/* True if [lo1, hi1) and [lo2, hi2) on the same device intersect */
+static NPY_INLINE int
+_ranges_overlap(int dev1, char *lo1, char *hi1,
+                int dev2, char *lo2, char *hi2)
+{
+    return dev1 == dev2 && lo1 < hi2 && lo2 < hi1;
+}
+
+/*
+ * Waits for the transfers of the streams other than 'skip' that write
+ * the memory of 'array', or read it too if 'write' is set.
+ */
+static void
+_stream_fence(PyObject *array, int write, PyMicStreamObject *skip)
+{
+    PyMicStreamObject *stream;
+    mpy_stream_job *job;
+    npy_intp lower, upper, seq;
+    char *lo, *hi;
+    int device;
+
+    if (live_streams == NULL) {
+        return;
+    }
+    if (PyMicArray_Check(array)) {
+        device = PyMicArray_DEVICE((PyMicArrayObject *)array);
+    }
+    else if (PyArray_Check(array)) {
+        device = CPU_DEVICE;
+    }
+    else {
+        return;
+    }
+    offset_bounds_from_strides(PyArray_ITEMSIZE((PyArrayObject *)array),
+                               PyArray_NDIM((PyArrayObject *)array),
+                               PyArray_DIMS((PyArrayObject *)array),
+                               PyArray_STRIDES((PyArrayObject *)array),
+                               &lower, &upper);
+    if (lower == upper) {
+        return;
+    }
+    lo = PyArray_BYTES((PyArrayObject *)array) + lower;
+    hi = PyArray_BYTES((PyArrayObject *)array) + upper;
+
+    for (stream = live_streams; stream != NULL; stream = stream->next) {
+        if (stream == skip) {
+            continue;
+        }
+        seq = 0;
+        pthread_mutex_lock(&stream->lock);
+        for (job = stream->head; job != NULL; job = job->next) {
+            if (_ranges_overlap(device, lo, hi, job->dst_device,
+                                job->dst, job->dst + job->nbytes) ||
+                    (write && _ranges_overlap(device, lo, hi,
+                                job->src_device, job->src,
+                                job->src + job->nbytes))) {
+                seq = job->seq;
+            }
+        }
+        pthread_mutex_unlock(&stream->lock);
+        if (seq > 0) {
+            _stream_wait_seq(stream, seq);
+        }
+    }
+}
+
+/*NUMPY_API
+ * Waits for the pending transfers, on any stream, that write the memory
+ * of 'array', a micpy or numpy array, or that read it if 'write' is set.
+ * Call it before an operation reads (write = 0) or writes (write = 1)
+ * 'array'.
+ */
+NPY_NO_EXPORT void
+PyMicStream_Fence(PyObject *array, int write)
+{
+    _stream_fence(array, write, NULL);
+}
+
+static int
+_same_strides(int ndim, npy_intp *a, npy_intp *b)
+{
+    int i;
+    for (i = 0; i < ndim; ++i) {
+        if (a[i] != b[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Upload 'array' to 'device' on 'stream', or into 'out' if it is not
+ * NULL.  Returns a new Transfer whose wait() gives back the device array.
+ */
+NPY_NO_EXPORT PyObject *
+PyMicStream_ToDevice(PyMicStreamObject *stream, PyArrayObject *array,
+                     int device, PyMicArrayObject *out)
+{
+    PyArrayObject *host = array;
+    PyMicArrayObject *ret;
+    PyMicTransferObject *transfer;
+    npy_intp nbytes;
+
+    Py_INCREF(host);
+    if (!PyArray_ISONESEGMENT(host)) {
+        PyArrayObject *tmp = mpy_pinned_like(host, NULL);
+
+        _stream_fence((PyObject *)host, 0, NULL);
+        if (tmp == NULL || PyArray_CopyInto(tmp, host) < 0) {
+            Py_XDECREF(tmp);
+            Py_DECREF(host);
+            return NULL;
+        }
+        Py_DECREF(host);
+        host = tmp;
+    }
+
+    if (out != NULL) {
+        if (PyMicArray_FailUnlessWriteable(out, "out array") < 0) {
+            Py_DECREF(host);
+            return NULL;
+        }
+        Py_INCREF(out);
+        ret = out;
+        device = PyMicArray_DEVICE(out);
+    }
+    else {
+        ret = (PyMicArrayObject *)PyMicArray_NewLikeArray(device, host,
+                                                NPY_KEEPORDER, NULL, 0);
+        if (ret == NULL) {
+            Py_DECREF(host);
+            return NULL;
+        }
+    }
+
+    nbytes = PyArray_NBYTES(host);
+    transfer = _transfer_new(stream, (PyObject *)ret, (PyObject *)host);
+    Py_DECREF(ret);
+    Py_DECREF(host);
+    if (transfer == NULL) {
+        return NULL;
+    }
+
+    /* Other streams may still be using the buffers */
+    _stream_fence((PyObject *)ret, 1, stream);
+    _stream_fence((PyObject *)host, 0, stream);
+
+    if (nbytes == 0) {
+        transfer->done = 1;
+    }
+    else if (!PyArray_ISONESEGMENT((PyArrayObject *)ret) ||
+             !PyArray_EquivTypes(PyArray_DESCR(host), PyMicArray_DESCR(ret)) ||
+             !_same_strides(PyArray_NDIM(host), PyArray_STRIDES(host),
+                            PyMicArray_STRIDES(ret))) {
+        /* Layouts or types differ, nothing to overlap with */
+        if (PyMicStream_Synchronize((PyObject *)stream) < 0 ||
+                PyMicArray_CopyIntoFromHost(ret, host) < 0) {
+            Py_DECREF(transfer);
+            return NULL;
+        }
+        transfer->done = 1;
+    }
+    else {
+        _stream_copy(stream, PyMicArray_BYTES(ret), device,
+                     PyArray_BYTES(host), CPU_DEVICE, nbytes, transfer);
+    }
+
+    return (PyObject *)transfer;
+}
+
+/*
+ * Download 'array' on 'stream', into 'out' if it is not NULL.  Returns
+ * a new Transfer whose wait() gives back the numpy array.
+ */
+NPY_NO_EXPORT PyObject *
+PyMicStream_ToHost(PyMicStreamObject *stream, PyMicArrayObject *array,
+                   PyArrayObject *out)
+{
+    PyMicArrayObject *src = array;
+    PyArrayObject *ret;
+    PyMicTransferObject *transfer;
+    npy_intp nbytes;
+
+    Py_INCREF(src);
+    if (!PyMicArray_ISONESEGMENT(src)) {
+        PyMicArrayObject *tmp;
+
+        /* Pending uploads may still be writing the source */
+        _stream_fence((PyObject *)src, 0, NULL);
+        tmp = (PyMicArrayObject *)PyMicArray_NewCopy(src, NPY_KEEPORDER);
+        Py_DECREF(src);
+        if (tmp == NULL) {
+            return NULL;
+        }
+        src = tmp;
+    }
+
+    if (out != NULL) {
+        if (PyArray_FailUnlessWriteable(out, "out array") < 0) {
+            Py_DECREF(src);
+            return NULL;
+        }
+        Py_INCREF(out);
+        ret = out;
+    }
+    else {
+        ret = mpy_pinned_like((PyArrayObject *)src, NULL);
+        if (ret == NULL) {
+            Py_DECREF(src);
+            return NULL;
+        }
+    }
+
+    nbytes = PyMicArray_NBYTES(src);
+    transfer = _transfer_new(stream, (PyObject *)ret, (PyObject *)src);
+    Py_DECREF(ret);
+    Py_DECREF(src);
+    if (transfer == NULL) {
+        return NULL;
+    }
+
+    /* Other streams may still be using the buffers */
+    _stream_fence((PyObject *)ret, 1, stream);
+    _stream_fence((PyObject *)src, 0, stream);
+
+    if (nbytes == 0) {
+        transfer->done = 1;
+    }
+    else if (!PyArray_ISONESEGMENT(ret) ||
+             !PyArray_EquivTypes(PyArray_DESCR(ret), PyMicArray_DESCR(src)) ||
+             !_same_strides(PyArray_NDIM(ret), PyArray_STRIDES(ret),
+                            PyMicArray_STRIDES(src))) {
+        if (PyMicStream_Synchronize((PyObject *)stream) < 0 ||
+                PyMicArray_CopyIntoHost(ret, src) < 0) {
+            Py_DECREF(transfer);
+            return NULL;
+        }
+        transfer->done = 1;
+    }
+    else {
+        _stream_copy(stream, PyArray_BYTES(ret), CPU_DEVICE,
+                     PyMicArray_BYTES(src), PyMicArray_DEVICE(src),
+                     nbytes, transfer);
+    }
+
+    return (PyObject *)transfer;
+}
+
+/*NUMPY_API
+ * Blocks until every transfer issued on 'stream' has completed.
+ * Returns 0 on success, -1 with an exception set if 'stream' is not
+ * a Stream.
+ */
+NPY_NO_EXPORT int
+PyMicStream_Synchronize(PyObject *stream)
+{
+    PyMicStreamObject *self = (PyMicStreamObject *)stream;
+
+    if (!PyMicStream_Check(stream)) {
+        PyErr_SetString(PyExc_TypeError, "stream must be a micpy.Stream");
+        return -1;
+    }
+
+    _stream_wait(self);
+
+    return 0;
+}
+
+
+/******************* Stream python object *******************/
+
+static PyObject *
+stream_new(PyTypeObject *subtype, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {NULL};
+    PyMicStreamObject *self;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, ":Stream", kwlist)) {
+        return NULL;
+    }
+
+    self = (PyMicStreamObject *)subtype->tp_alloc(subtype, 0);
+    if (self == NULL) {
+        return NULL;
+    }
+    self->head = self->tail = NULL;
+    self->issued = self->finished = 0;
+    self->has_worker = self->closing = 0;
+    pthread_mutex_init(&self->lock, NULL);
+    pthread_cond_init(&self->cond, NULL);
+
+    self->prev = NULL;
+    self->next = live_streams;
+    if (live_streams != NULL) {
+        live_streams->prev = self;
+    }
+    live_streams = self;
+
+    return (PyObject *)self;
+}
+
+static void
+stream_dealloc(PyMicStreamObject *self)
+{
+    NPY_BEGIN_THREADS_DEF;
+
+    /*
+     * Pending transfers hold a reference and wait when deallocated, so
+     * nothing is queued, only the worker is left to stop
+     */
+    if (self->has_worker) {
+        pthread_mutex_lock(&self->lock);
+        self->closing = 1;
+        pthread_cond_broadcast(&self->cond);
+        pthread_mutex_unlock(&self->lock);
+        NPY_BEGIN_THREADS;
+        pthread_join(self->worker, NULL);
+        NPY_END_THREADS;
+    }
+    pthread_cond_destroy(&self->cond);
+    pthread_mutex_destroy(&self->lock);
+
+    if (self->prev != NULL) {
+        self->prev->next = self->next;
+    }
+    else {
+        live_streams = self->next;
+    }
+    if (self->next != NULL) {
+        self->next->prev = self->prev;
+    }
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *
+stream_synchronize(PyObject *self, PyObject *NPY_UNUSED(args))
+{
+    if (PyMicStream_Synchronize(self) < 0) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+stream_done(PyMicStreamObject *self, PyObject *NPY_UNUSED(args))
+{
+    int done;
+
+    pthread_mutex_lock(&self->lock);
+    done = (self->finished == self->issued);
+    pthread_mutex_unlock(&self->lock);
+    if (done) {
+        Py_RETURN_TRUE;
+    }
+    Py_RETURN_FALSE;
+}
+
+static PyMethodDef stream_methods[] = {
+    {"synchronize",
+        (PyCFunction)stream_synchronize,
+        METH_NOARGS, "Wait for all transfers issued on the stream."},
+    {"done",
+        (PyCFunction)stream_done,
+        METH_NOARGS, "True if all transfers on the stream have completed."},
+    {NULL, NULL, 0, NULL}
+};
+
+NPY_NO_EXPORT PyTypeObject PyMicStream_Type = {
+#if defined(NPY_PY3K)
+    PyVarObject_HEAD_INIT(NULL, 0)
+#else
+    PyObject_HEAD_INIT(NULL)
+    0,                                          /* ob_size */
+#endif
+    "micpy.Stream",                             /* tp_name */
+    sizeof(PyMicStreamObject),                  /* tp_basicsize */
+    0,                                          /* tp_itemsize */
+    /* methods */
+    (destructor)stream_dealloc,                 /* tp_dealloc */
+    (printfunc)NULL,                            /* tp_print */
+    0,                                          /* tp_getattr */
+    0,                                          /* tp_setattr */
+#if defined(NPY_PY3K)
+    0,                                          /* tp_reserved */
+#else
+    0,                                          /* tp_compare */
+#endif
+    0,                                          /* tp_repr */
+    0,                                          /* tp_as_number */
+    0,                                          /* tp_as_sequence */
+    0,                                          /* tp_as_mapping */
+    0,                                          /* tp_hash */
+    0,                                          /* tp_call */
+    0,                                          /* tp_str */
+    0,                                          /* tp_getattro */
+    0,                                          /* tp_setattro */
+    0,                                          /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                         /* tp_flags */
+    0,                                          /* tp_doc */
+    0,                                          /* tp_traverse */
+    0,                                          /* tp_clear */
+    0,                                          /* tp_richcompare */
+    0,                                          /* tp_weaklistoffset */
+    0,                                          /* tp_iter */
+    0,                                          /* tp_iternext */
+    stream_methods,                             /* tp_methods */
+    0,                                          /* tp_members */
+    0,                                          /* tp_getset */
+    0,                                          /* tp_base */
+    0,                                          /* tp_dict */
+    0,                                          /* tp_descr_get */
+    0,                                          /* tp_descr_set */
+    0,                                          /* tp_dictoffset */
+    0,                                          /* tp_init */
+    0,                                          /* tp_alloc */
+    stream_new,                                 /* tp_new */
+};
+
+
+/******************* Transfer python object *******************/
+
+static void
+transfer_dealloc(PyMicTransferObject *self)
+{
+    /* The worker still writes into 'done' and the arrays */
+    _stream_wait_seq(self->stream, self->seq);
+    Py_XDECREF(self->stream);
+    Py_XDECREF(self->result);
+    Py_XDECREF(self->source);
+    PyObject_Del(self);
+}
+
+static PyObject *
+transfer_wait(PyMicTransferObject *self, PyObject *NPY_UNUSED(args))
+{
+    if (_transfer_wait(self) < 0) {
+        return NULL;
+    }
+    Py_CLEAR(self->source);
+    Py_INCREF(self->result);
+    return self->result;
+}
+
+static PyObject *
+transfer_done(PyMicTransferObject *self, PyObject *NPY_UNUSED(args))
+{
+    if (_transfer_status(self) != 0) {
+        Py_RETURN_TRUE;
+    }
+    Py_RETURN_FALSE;
+}
+
+static PyObject *
+transfer_stream_get(PyMicTransferObject *self)
+{
+    Py_INCREF(self->stream);
+    return (PyObject *)self->stream;
+}
+
+static PyMethodDef transfer_methods[] = {
+    {"wait",
+        (PyCFunction)transfer_wait,
+        METH_NOARGS, "Wait for the transfer and return the copied array."},
+    {"done",
+        (PyCFunction)transfer_done,
+        METH_NOARGS, "True if the transfer has completed."},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyGetSetDef transfer_getset[] = {
+    {"stream",
+        (getter)transfer_stream_get,
+        NULL, NULL, NULL},
+    {NULL, NULL, NULL, NULL, NULL},
+};
+
+NPY_NO_EXPORT PyTypeObject PyMicTransfer_Type = {
+#if defined(NPY_PY3K)
+    PyVarObject_HEAD_INIT(NULL, 0)
+#else
+    PyObject_HEAD_INIT(NULL)
+    0,                                          /* ob_size */
+#endif
+    "micpy.Transfer",                           /* tp_name */
+    sizeof(PyMicTransferObject),                /* tp_basicsize */
+    0,                                          /* tp_itemsize */
+    /* methods */
+    (destructor)transfer_dealloc,               /* tp_dealloc */
+    (printfunc)NULL,                            /* tp_print */
+    0,                                          /* tp_getattr */
+    0,                                          /* tp_setattr */
+#if defined(NPY_PY3K)
+    0,                                          /* tp_reserved */
+#else
+    0,                                          /* tp_compare */
+#endif
+    0,                                          /* tp_repr */
+    0,                                          /* tp_as_number */
+    0,                                          /* tp_as_sequence */
+    0,                                          /* tp_as_mapping */
+    0,                                          /* tp_hash */
+    0,                                          /* tp_call */
+    0,                                          /* tp_str */
+    0,                                          /* tp_getattro */
+    0,                                          /* tp_setattro */
+    0,                                          /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                         /* tp_flags */
+    0,                                          /* tp_doc */
+    0,                                          /* tp_traverse */
+    0,                                          /* tp_clear */
+    0,                                          /* tp_richcompare */
+    0,                                          /* tp_weaklistoffset */
+    0,                                          /* tp_iter */
+    0,                                          /* tp_iternext */
+    transfer_methods,                           /* tp_methods */
+    0,                                          /* tp_members */
+    transfer_getset,                            /* tp_getset */
+};
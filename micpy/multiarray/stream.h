@@ -0,0 +1,62 @@
+#ifndef _MPY_STREAM_H_
+#define _MPY_STREAM_H_
+
+#include <pthread.h>
+#include <numpy/ndarraytypes.h>
+#include "arrayobject.h"
+
+/*
+ * Transfers issued on a Stream are copied by a worker thread of the
+ * stream, in issue order within the stream.
+ */
+typedef struct _PyMicTransferObject PyMicTransferObject;
+typedef struct _mpy_stream_job mpy_stream_job;
+
+typedef struct _PyMicStreamObject {
+    PyObject_HEAD
+    /* Copies not finished yet, oldest first, the head one is running */
+    mpy_stream_job *head, *tail;
+    /* Numbers of the last issued and of the last finished copy */
+    npy_intp issued, finished;
+    /* Guards the fields above, cond signals a queued or finished copy */
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t worker;
+    int has_worker, closing;
+    /* Neighbours in the list of live streams */
+    struct _PyMicStreamObject *prev, *next;
+} PyMicStreamObject;
+
+struct _PyMicTransferObject {
+    PyObject_HEAD
+    /* Set by the worker to 1 when the copy has landed, -1 if it failed */
+    int done;
+    /* Number of the copy on its stream, 0 if it was not queued */
+    npy_intp seq;
+    PyMicStreamObject *stream;
+    /* Array returned by wait() */
+    PyObject *result;
+    /* Array read by the transfer, kept alive until it completes */
+    PyObject *source;
+};
+
+extern NPY_NO_EXPORT PyTypeObject PyMicStream_Type;
+extern NPY_NO_EXPORT PyTypeObject PyMicTransfer_Type;
+
+#define PyMicStream_Check(op) PyObject_TypeCheck(op, &PyMicStream_Type)
+
+NPY_NO_EXPORT int
+PyMicStream_Synchronize(PyObject *stream);
+
+NPY_NO_EXPORT void
+PyMicStream_Fence(PyObject *array, int write);
+
+NPY_NO_EXPORT PyObject *
+PyMicStream_ToDevice(PyMicStreamObject *stream, PyArrayObject *array,
+                     int device, PyMicArrayObject *out);
+
+NPY_NO_EXPORT PyObject *
+PyMicStream_ToHost(PyMicStreamObject *stream, PyMicArrayObject *array,
+                   PyArrayObject *out);
+
+#endif
@@ -437,3 +437,91 @@ def argmin(a, axis=None, out=None):
 
     """
     return _wrapfunc(a, 'argmin', axis=axis, out=out)
+
+
+def cumsum(a, axis=None, dtype=None, out=None):
+    """
+    Return the cumulative sum of the elements along a given axis.
+
+    Parameters
+    ----------
+    a : array_like
+        Input array.
+    axis : int, optional
+        Axis along which the cumulative sum is computed. The default
+        (None) is to compute the cumsum over the flattened array.
+    dtype : dtype, optional
+        Type of the returned array and of the accumulator in which the
+        elements are summed.  If `dtype` is not specified, it defaults
+        to the dtype of `a`, unless `a` has an integer dtype with a
+        precision less than that of the default platform integer.  In
+        that case, the default platform integer is used.
+    out : ndarray, optional
+        Alternative output array in which to place the result. It must
+        have the same shape as the expected output.
+
+    Returns
+    -------
+    cumsum_along_axis : ndarray.
+        A new array holding the result is returned unless `out` is
+        specified, in which case a reference to `out` is returned.
+
+    See Also
+    --------
+    add.accumulate, cumprod
+
+    Notes
+    -----
+    Long scans are split over the device threads, so floating point
+    results may differ from a serial sum in the last bits.
+
+    Examples
+    --------
+    >>> a = mp.array([[1,2,3], [4,5,6]])
+    >>> mp.cumsum(a)
+    array([ 1,  3,  6, 10, 15, 21])
+    >>> mp.cumsum(a, axis=0)
+    array([[1, 2, 3],
+           [5, 7, 9]])
+
+    """
+    return _wrapfunc(a, 'cumsum', axis=axis, dtype=dtype, out=out)
+
+
+def cumprod(a, axis=None, dtype=None, out=None):
+    """
+    Return the cumulative product of elements along a given axis.
+
+    Parameters
+    ----------
+    a : array_like
+        Input array.
+    axis : int, optional
+        Axis along which the cumulative product is computed.  By default
+        the input is flattened.
+    dtype : dtype, optional
+        Type of the returned array, as well as of the accumulator in
+        which the elements are multiplied.  See `cumsum` for the default.
+    out : ndarray, optional
+        Alternative output array in which to place the result. It must
+        have the same shape as the expected output.
+
+    Returns
+    -------
+    cumprod : ndarray
+        A new array holding the result is returned unless `out` is
+        specified, in which case a reference to out is returned.
+
+    See Also
+    --------
+    multiply.accumulate, cumsum
+
+    Examples
+    --------
+    >>> a = mp.array([[1, 2, 3], [4, 5, 6]])
+    >>> mp.cumprod(a, axis=1)
+    array([[  1,   2,   6],
+           [  4,  20, 120]])
+
+    """
+    return _wrapfunc(a, 'cumprod', axis=axis, dtype=dtype, out=out)
@@ -0,0 +1,373 @@
+/*
+ * Host/device dispatch of trivial ufunc loops.
+ *
+ * Offloading a loop costs a target region launch no matter how little
+ * work it carries, which dominates for the handful of elements typical
+ * of control code.  For such calls it can be cheaper to copy the
+ * operands to the host, run the very same inner loop there and copy
+ * the outputs back.  The decision is taken per call from a simple
+ * model:
+ *
+ *   device: offload_latency + bytes / device_bandwidth
+ *   host:   transfers * transfer_latency + bytes / link_bandwidth
+ *                                        + bytes / host_bandwidth
+ *
+ * The defaults are conservative guesses, calibrate() measures them on
+ * the current machine.  Nothing above host_threshold bytes is ever run
+ * on the host.
+ *
+ * Results must not depend on where a call runs.  Integer and boolean
+ * loops give the same results on both sides.  The coprocessor image is
+ * built with -fp-model fast=2, which flushes denormals to zero, treats
+ * denormal operands as zero and may use approximate division and
+ * square root, so any float loop that computes or compares values can
+ * differ from the host.  Of the float and double loops only those that
+ * just move or test the sign bit are run on the host.
+ */
+#include <Python.h>
+
+#define NPY_NO_DEPRECATED_API NPY_API_VERSION
+#define PY_ARRAY_UNIQUE_SYMBOL _mpy_umathmodule_ARRAY_API
+#define NO_IMPORT_ARRAY
+#define PY_UFUNC_UNIQUE_SYMBOL _mpy_umathmodule_UFUNC_API
+#define NO_IMPORT_UFUNC
+#include <numpy/npy_common.h>
+#include <numpy/arrayobject.h>
+#include <numpy/ufuncobject.h>
+#include <numpy/npy_3kcompat.h>
+
+#define PyMicArray_API_UNIQUE_NAME _mpy_umathmodule_MICARRAY_API
+#define PyMicArray_NO_IMPORT
+#include <multiarray/arrayobject.h>
+#include <multiarray/multiarray_api.h>
+#include <multiarray/mpy_common.h>
+#include <multiarray/common.h>
+
+#include "dispatch.h"
+
+#define MPY_CALIBRATE_REPEAT 20
+#define MPY_CALIBRATE_BYTES (8 << 20)
+
+static mpy_dispatch_config dispatch_config = {
+    4096,       /* host_threshold */
+    50e-6,      /* offload_latency */
+    20e-6,      /* transfer_latency */
+    6e9,        /* link_bandwidth */
+    5e9,        /* host_bandwidth */
+    100e9,      /* device_bandwidth */
+};
+
+/* Ufuncs whose float/double loops are bit exact under the device fp model */
+static const char *exact_ufuncs[] = {
+    "negative", "positive", "absolute", "fabs", "copysign", "signbit",
+    NULL
+};
+
+static int
+_is_exact_on_host(PyUFuncObject *ufunc, int nop, PyMicArrayObject **op)
+{
+    int i, any_float = 0;
+    const char **name;
+
+    for (i = 0; i < nop; ++i) {
+        int type_num = PyMicArray_TYPE(op[i]);
+
+        if (PyTypeNum_ISBOOL(type_num) || PyTypeNum_ISINTEGER(type_num)) {
+            continue;
+        }
+        if (type_num == NPY_FLOAT || type_num == NPY_DOUBLE) {
+            any_float = 1;
+            continue;
+        }
+        return 0;
+    }
+
+    if (!any_float) {
+        return 1;
+    }
+    if (ufunc->name == NULL) {
+        return 0;
+    }
+    for (name = exact_ufuncs; *name != NULL; ++name) {
+        if (strcmp(ufunc->name, *name) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Outputs with gaps between elements have to be read before written */
+static NPY_INLINE int
+_is_gapped(PyMicArrayObject *arr, npy_intp count)
+{
+    return count > 1 && PyMicArray_NDIM(arr) == 1 &&
+           PyMicArray_STRIDE(arr, 0) != PyMicArray_ITEMSIZE(arr);
+}
+
+/*
+ * Returns 1 if the trivial loop over 'count' elements of the operands
+ * is predicted to be faster on the host.  Must be called with the GIL.
+ */
+NPY_NO_EXPORT int
+mpy_dispatch_use_host(PyUFuncObject *ufunc, int nin, int nop,
+                      PyMicArrayObject **op, npy_intp count)
+{
+    const mpy_dispatch_config *cfg = &dispatch_config;
+    double bytes = 0, t_host, t_device;
+    int i, transfers = 0;
+
+    if (cfg->host_threshold <= 0 ||
+            MPY_IS_HOST_DEVICE(PyMicArray_DEVICE(op[0]))) {
+        return 0;
+    }
+
+    for (i = 0; i < nop; ++i) {
+        npy_intp itemsize = PyMicArray_ITEMSIZE(op[i]);
+
+        bytes += (PyMicArray_SIZE(op[i]) == 1) ? itemsize : count * itemsize;
+        transfers += (i >= nin && _is_gapped(op[i], count)) ? 2 : 1;
+    }
+
+    if (bytes > cfg->host_threshold) {
+        return 0;
+    }
+
+    t_device = cfg->offload_latency + bytes / cfg->device_bandwidth;
+    t_host = transfers * cfg->transfer_latency +
+             bytes / cfg->link_bandwidth + bytes / cfg->host_bandwidth;
+    if (t_host >= t_device) {
+        return 0;
+    }
+
+    return _is_exact_on_host(ufunc, nop, op);
+}
+
+/*
+ * Runs the inner loop on host copies of the operands.  'data' and
+ * 'stride' describe the trivial iteration on the device as prepared by
+ * the caller.  Safe to call without the GIL.
+ *
+ * Returns 0 on success, -1 if staging failed, in which case the outputs
+ * are untouched and the loop should be offloaded as usual.
+ */
+NPY_NO_EXPORT int
+mpy_dispatch_host_loop(PyUFuncGenericFunction innerloop,
+                       void *innerloopdata,
+                       int nin, int nop, PyMicArrayObject **op,
+                       char **data, npy_intp *stride, npy_intp count)
+{
+    char *staged[NPY_MAXARGS], *host[NPY_MAXARGS];
+    npy_intp offset[NPY_MAXARGS], span[NPY_MAXARGS];
+    int i, device = PyMicArray_DEVICE(op[0]);
+    int ret = -1;
+
+    for (i = 0; i < nop; ++i) {
+        staged[i] = NULL;
+    }
+
+    for (i = 0; i < nop; ++i) {
+        npy_intp itemsize = PyMicArray_ITEMSIZE(op[i]);
+        npy_intp extent = (count > 0) ? (count - 1) * stride[i] : 0;
+
+        /* Negative strides start 'extent' bytes before the data pointer */
+        offset[i] = (extent < 0) ? extent : 0;
+        span[i] = ((extent < 0) ? -extent : extent) + itemsize;
+
+        staged[i] = malloc(span[i]);
+        if (staged[i] == NULL) {
+            goto finish;
+        }
+        if (i < nin || _is_gapped(op[i], count)) {
+            if (target_memcpy(staged[i], data[i] + offset[i], span[i],
+                              CPU_DEVICE, device) != 0) {
+                goto finish;
+            }
+        }
+        host[i] = staged[i] - offset[i];
+    }
+
+    innerloop(host, &count, stride, innerloopdata);
+
+    for (i = nin; i < nop; ++i) {
+        if (target_memcpy(data[i] + offset[i], staged[i], span[i],
+                          device, CPU_DEVICE) != 0) {
+            goto finish;
+        }
+    }
+    ret = 0;
+
+finish:
+    for (i = 0; i < nop; ++i) {
+        free(staged[i]);
+    }
+    return ret;
+}
+
+static PyObject *
+_config_as_dict(void)
+{
+    const mpy_dispatch_config *cfg = &dispatch_config;
+
+    return Py_BuildValue("{s:n,s:d,s:d,s:d,s:d,s:d}",
+                         "host_threshold", cfg->host_threshold,
+                         "offload_latency", cfg->offload_latency,
+                         "transfer_latency", cfg->transfer_latency,
+                         "link_bandwidth", cfg->link_bandwidth,
+                         "host_bandwidth", cfg->host_bandwidth,
+                         "device_bandwidth", cfg->device_bandwidth);
+}
+
+NPY_NO_EXPORT PyObject *
+mpy_dispatch_get_config(PyObject *NPY_UNUSED(self),
+                        PyObject *NPY_UNUSED(args))
+{
+    return _config_as_dict();
+}
+
+NPY_NO_EXPORT PyObject *
+mpy_dispatch_set_config(PyObject *NPY_UNUSED(self), PyObject *args,
+                        PyObject *kwds)
+{
+    static char *kwlist[] = {"host_threshold", "offload_latency",
+                             "transfer_latency", "link_bandwidth",
+                             "host_bandwidth", "device_bandwidth", NULL};
+    mpy_dispatch_config cfg = dispatch_config;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds,
+                                     "|nddddd:_set_dispatch_config", kwlist,
+                                     &cfg.host_threshold,
+                                     &cfg.offload_latency,
+                                     &cfg.transfer_latency,
+                                     &cfg.link_bandwidth,
+                                     &cfg.host_bandwidth,
+                                     &cfg.device_bandwidth)) {
+        return NULL;
+    }
+    if (cfg.offload_latency < 0 || cfg.transfer_latency < 0 ||
+            cfg.link_bandwidth <= 0 || cfg.host_bandwidth <= 0 ||
+            cfg.device_bandwidth <= 0) {
+        PyErr_SetString(PyExc_ValueError,
+                "latencies must be non-negative and bandwidths positive");
+        return NULL;
+    }
+
+    dispatch_config = cfg;
+    return _config_as_dict();
+}
+
+/* Best of MPY_CALIBRATE_REPEAT runs of 'stmt', in seconds */
+#define MPY_TIME_BEST(best, stmt) do { \
+            int _rep; \
+            (best) = NPY_INFINITY; \
+            for (_rep = 0; _rep < MPY_CALIBRATE_REPEAT; ++_rep) { \
+                double _t = omp_get_wtime(); \
+                stmt; \
+                _t = omp_get_wtime() - _t; \
+                if (_t < (best)) { \
+                    (best) = _t; \
+                } \
+            } \
+        } while (0)
+
+static void
+_empty_offload(int device)
+{
+#pragma omp target device(device)
+    {}
+}
+
+static void
+_device_memcpy(void *dst, void *src, size_t nbytes, int device)
+{
+#pragma omp target device(device) map(to: dst, src, nbytes)
+    memcpy(dst, src, nbytes);
+}
+
+/*
+ * _calibrate_dispatch(device=None)
+ * Measures the model parameters on 'device' and makes them current.
+ * host_threshold is left alone.
+ */
+NPY_NO_EXPORT PyObject *
+mpy_dispatch_calibrate(PyObject *NPY_UNUSED(self), PyObject *args,
+                       PyObject *kwds)
+{
+    static char *kwlist[] = {"device", NULL};
+    PyObject *device_obj = Py_None;
+    mpy_dispatch_config cfg = dispatch_config;
+    const size_t nbytes = MPY_CALIBRATE_BYTES;
+    char *host_a = NULL, *host_b = NULL;
+    void *dev_a = NULL, *dev_b = NULL;
+    double t_empty, t_small, t_link, t_host, t_device;
+    int device, failed = 0;
+
+    NPY_BEGIN_THREADS_DEF;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O:_calibrate_dispatch",
+                                     kwlist, &device_obj)) {
+        return NULL;
+    }
+    if (device_obj == Py_None) {
+        device = PyMicArray_GetCurrentDevice();
+    }
+    else {
+        device = (int)PyInt_AsLong(device_obj);
+        if (error_converting(device)) {
+            return NULL;
+        }
+    }
+    if (MPY_IS_HOST_DEVICE(device)) {
+        /* Nothing to decide in host-device mode */
+        return _config_as_dict();
+    }
+
+    host_a = malloc(nbytes);
+    host_b = malloc(nbytes);
+    dev_a = target_alloc(nbytes, device);
+    dev_b = target_alloc(nbytes, device);
+    if (host_a == NULL || host_b == NULL || dev_a == NULL || dev_b == NULL) {
+        PyErr_NoMemory();
+        goto finish;
+    }
+    memset(host_a, 0, nbytes);
+    memset(host_b, 0, nbytes);
+
+    NPY_BEGIN_THREADS;
+
+    MPY_TIME_BEST(t_empty, _empty_offload(device));
+    MPY_TIME_BEST(t_small,
+        failed |= target_memcpy(dev_a, host_a, 1, device, CPU_DEVICE));
+    MPY_TIME_BEST(t_link,
+        failed |= target_memcpy(dev_a, host_a, nbytes, device, CPU_DEVICE));
+    MPY_TIME_BEST(t_host, memcpy(host_b, host_a, nbytes));
+    MPY_TIME_BEST(t_device, _device_memcpy(dev_b, dev_a, nbytes, device));
+
+    NPY_END_THREADS;
+
+    if (failed) {
+        PyErr_SetString(PyExc_RuntimeError,
+                "host <-> device copy failed during calibration");
+        goto finish;
+    }
+
+    cfg.offload_latency = t_empty;
+    cfg.transfer_latency = t_small;
+    cfg.link_bandwidth = nbytes / PyArray_MAX(t_link - t_small, 1e-9);
+    cfg.host_bandwidth = nbytes / PyArray_MAX(t_host, 1e-9);
+    cfg.device_bandwidth = nbytes / PyArray_MAX(t_device - t_empty, 1e-9);
+    dispatch_config = cfg;
+
+finish:
+    free(host_a);
+    free(host_b);
+    if (dev_a != NULL) {
+        target_free(dev_a, device);
+    }
+    if (dev_b != NULL) {
+        target_free(dev_b, device);
+    }
+    if (PyErr_Occurred()) {
+        return NULL;
+    }
+    return _config_as_dict();
+}
@@ -0,0 +1,43 @@
+#ifndef _MPY_MUFUNC_DISPATCH_H
+#define _MPY_MUFUNC_DISPATCH_H
+
+/*
+ * Latency/bandwidth model used to decide whether a tiny trivial ufunc
+ * loop is cheaper to stage to the host than to offload.
+ */
+typedef struct {
+    /* Largest operand footprint (bytes) ever run on the host, 0 disables */
+    npy_intp host_threshold;
+    /* Cost of an empty target region, in seconds */
+    double offload_latency;
+    /* Cost of a one byte host <-> device copy, in seconds */
+    double transfer_latency;
+    /* Bytes per second of the respective paths */
+    double link_bandwidth;
+    double host_bandwidth;
+    double device_bandwidth;
+} mpy_dispatch_config;
+
+NPY_NO_EXPORT int
+mpy_dispatch_use_host(PyUFuncObject *ufunc, int nin, int nop,
+                      PyMicArrayObject **op, npy_intp count);
+
+NPY_NO_EXPORT int
+mpy_dispatch_host_loop(PyUFuncGenericFunction innerloop,
+                       void *innerloopdata,
+                       int nin, int nop, PyMicArrayObject **op,
+                       char **data, npy_intp *stride, npy_intp count);
+
+NPY_NO_EXPORT PyObject *
+mpy_dispatch_get_config(PyObject *NPY_UNUSED(self),
+                        PyObject *NPY_UNUSED(args));
+
+NPY_NO_EXPORT PyObject *
+mpy_dispatch_set_config(PyObject *NPY_UNUSED(self), PyObject *args,
+                        PyObject *kwds);
+
+NPY_NO_EXPORT PyObject *
+mpy_dispatch_calibrate(PyObject *NPY_UNUSED(self), PyObject *args,
+                       PyObject *kwds);
+
+#endif
@@ -0,0 +1,117 @@
+/*
+ * Wraps inner loops compiled at run time by micpy.ElementwiseKernel
+ * into mufuncs.
+ */
+#include <Python.h>
+
+#define NPY_NO_DEPRECATED_API NPY_API_VERSION
+#define PY_ARRAY_UNIQUE_SYMBOL _mpy_umathmodule_ARRAY_API
+#define NO_IMPORT_ARRAY
+#define PY_UFUNC_UNIQUE_SYMBOL _mpy_umathmodule_UFUNC_API
+#define NO_IMPORT_UFUNC
+#include <numpy/npy_common.h>
+#include <numpy/arrayobject.h>
+#include <numpy/ufuncobject.h>
+#include <numpy/npy_3kcompat.h>
+
+#define PyMicArray_API_UNIQUE_NAME _mpy_umathmodule_MICARRAY_API
+#define PyMicArray_NO_IMPORT
+#include <multiarray/arrayobject.h>
+#include <multiarray/multiarray_api.h>
+#include <multiarray/mpy_common.h>
+#include <multiarray/common.h>
+
+#define _MICARRAY_UMATHMODULE
+#include "mufunc_object.h"
+#include "elementwise.h"
+
+#define MPY_KERNEL_CAPSULE_NAME "micpy.kernel_loop"
+
+/*
+ * The ufunc keeps pointers to its loop table, types, name and doc, so
+ * they live in one block owned by the ufunc.
+ */
+typedef struct {
+    PyUFuncGenericFunction functions[1];
+    void *data[1];
+    char types[NPY_MAXARGS];
+    char strings[1];
+} mpy_kernel_loop;
+
+static void
+_kernel_loop_free(PyObject *capsule)
+{
+    PyArray_free(PyCapsule_GetPointer(capsule, MPY_KERNEL_CAPSULE_NAME));
+}
+
+/*
+ * _ufunc_from_kernel(address, type_nums, nin, nout, name, doc, owner)
+ *
+ * Makes a mufunc with the single inner loop at 'address', which is the
+ * address of the loop in the code of the device the mufunc is for, as
+ * looked up on that device.  'owner' is kept alive as long as the
+ * ufunc, it is the handle of the shared object the loop lives in.
+ */
+NPY_NO_EXPORT PyObject *
+mpy_ufunc_from_kernel(PyObject *NPY_UNUSED(self), PyObject *args)
+{
+    Py_ssize_t address;
+    PyObject *type_nums, *owner, *capsule;
+    PyUFuncObject *ufunc;
+    mpy_kernel_loop *loop;
+    const char *name, *doc;
+    size_t name_len, doc_len;
+    int i, nin, nout;
+
+    if (!PyArg_ParseTuple(args, "nO!iissO:_ufunc_from_kernel",
+                          &address, &PyTuple_Type, &type_nums,
+                          &nin, &nout, &name, &doc, &owner)) {
+        return NULL;
+    }
+    if (address == 0 || nin < 1 || nout < 1 || nin + nout > NPY_MAXARGS ||
+            PyTuple_GET_SIZE(type_nums) != nin + nout) {
+        PyErr_SetString(PyExc_ValueError, "invalid kernel description");
+        return NULL;
+    }
+
+    name_len = strlen(name) + 1;
+    doc_len = strlen(doc) + 1;
+    loop = PyArray_malloc(sizeof(mpy_kernel_loop) + name_len + doc_len);
+    if (loop == NULL) {
+        return PyErr_NoMemory();
+    }
+    loop->functions[0] = (PyUFuncGenericFunction)address;
+    loop->data[0] = NULL;
+    for (i = 0; i < nin + nout; ++i) {
+        long type_num = PyInt_AsLong(PyTuple_GET_ITEM(type_nums, i));
+        if (error_converting(type_num)) {
+            PyArray_free(loop);
+            return NULL;
+        }
+        loop->types[i] = (char)type_num;
+    }
+    memcpy(loop->strings, name, name_len);
+    memcpy(loop->strings + name_len, doc, doc_len);
+
+    capsule = PyCapsule_New(loop, MPY_KERNEL_CAPSULE_NAME, _kernel_loop_free);
+    if (capsule == NULL) {
+        PyArray_free(loop);
+        return NULL;
+    }
+
+    ufunc = (PyUFuncObject *)PyMUFunc_FromFuncAndData(loop->functions,
+                            loop->data, loop->types, 1, nin, nout,
+                            PyUFunc_None, loop->strings,
+                            loop->strings + name_len, 0);
+    if (ufunc == NULL) {
+        Py_DECREF(capsule);
+        return NULL;
+    }
+    ufunc->obj = Py_BuildValue("(NO)", capsule, owner);
+    if (ufunc->obj == NULL) {
+        Py_DECREF(ufunc);
+        return NULL;
+    }
+
+    return (PyObject *)ufunc;
+}
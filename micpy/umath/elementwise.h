@@ -0,0 +1,7 @@
+#ifndef _MPY_MUFUNC_ELEMENTWISE_H
+#define _MPY_MUFUNC_ELEMENTWISE_H
+
+NPY_NO_EXPORT PyObject *
+mpy_ufunc_from_kernel(PyObject *NPY_UNUSED(self), PyObject *args);
+
+#endif
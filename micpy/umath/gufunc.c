@@ -0,0 +1,113 @@
+/*
+ * Outer loop of generalized ufuncs.
+ *
+ * The broadcast (non-core) dimensions are walked on the device instead
+ * of offloading one call of the core loop per iterator step, so a
+ * stack of many tiny core problems costs a single offload.  The last
+ * broadcast dimension is cut into chunks of MPY_GUFUNC_CHUNK items and
+ * every (row, chunk) task is one call of the core loop, with the chunk
+ * length as dimensions[0] and the strides of that dimension as the
+ * outer steps.  The tasks are spread over the device threads.
+ */
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#define NPY_NO_DEPRECATED_API NPY_API_VERSION
+#define PY_ARRAY_UNIQUE_SYMBOL _mpy_umathmodule_ARRAY_API
+#define NO_IMPORT_ARRAY
+#define PY_UFUNC_UNIQUE_SYMBOL _mpy_umathmodule_UFUNC_API
+#define NO_IMPORT_UFUNC
+#include <numpy/npy_common.h>
+#include <numpy/arrayobject.h>
+#include <numpy/ufuncobject.h>
+#include <numpy/npy_3kcompat.h>
+
+#define PyMicArray_API_UNIQUE_NAME _mpy_umathmodule_MICARRAY_API
+#define PyMicArray_NO_IMPORT
+#include <multiarray/arrayobject.h>
+#include <multiarray/multiarray_api.h>
+#include <multiarray/mpy_common.h>
+#include <multiarray/common.h>
+
+#define _MICARRAY_UMATHMODULE
+#include "mufunc_object.h"
+#include "gufunc.h"
+
+/* Items of the last broadcast dimension handled by one call */
+#define MPY_GUFUNC_CHUNK 1024
+
+NPY_NO_EXPORT void
+mpy_gufunc_loop(PyUFuncGenericFunction innerloop, void *innerloopdata,
+                int device, int nop, char **dataptrs,
+                int ndim, npy_intp *shape, npy_intp *strides,
+                int ncore_dims, npy_intp *core_dims,
+                int ncore_strides, npy_intp *core_strides)
+{
+    MPY_TARGET_MIC PyUFuncGenericFunction loop = innerloop;
+    MPY_TARGET_MIC void *loopdata = innerloopdata;
+    npy_intp dims[NPY_MAXDIMS + 1];
+    npy_intp steps[NPY_MAXARGS * (NPY_MAXDIMS + 1)];
+    npy_intp one = 1, nsteps = nop + ncore_strides;
+    npy_intp zeros[NPY_MAXARGS];
+    int i;
+
+    /* No broadcast dimensions is a single item */
+    if (ndim == 0) {
+        memset(zeros, 0, nop * sizeof(npy_intp));
+        ndim = 1;
+        shape = &one;
+        strides = zeros;
+    }
+
+    dims[0] = 0;
+    memcpy(dims + 1, core_dims, ncore_dims * sizeof(npy_intp));
+    for (i = 0; i < nop; ++i) {
+        steps[i] = strides[(ndim - 1) * nop + i];
+    }
+    memcpy(steps + nop, core_strides, ncore_strides * sizeof(npy_intp));
+
+#pragma omp target device(device) map(to: loop, loopdata, nop, ndim, \
+                                          ncore_dims, \
+                                          dataptrs[0:nop], shape[0:ndim], \
+                                          strides[0:ndim*nop], \
+                                          dims[0:ncore_dims+1], \
+                                          steps[0:nsteps])
+    {
+        npy_intp len = shape[ndim - 1], rows = 1, nchunks, task;
+        int d;
+
+        for (d = 0; d < ndim - 1; ++d) {
+            rows *= shape[d];
+        }
+        nchunks = (len + MPY_GUFUNC_CHUNK - 1) / MPY_GUFUNC_CHUNK;
+
+        #pragma omp parallel for schedule(static)
+        for (task = 0; task < rows * nchunks; ++task) {
+            char *args[NPY_MAXARGS];
+            npy_intp count[NPY_MAXDIMS + 1];
+            npy_intp row = task / nchunks;
+            npy_intp start = (task % nchunks) * MPY_GUFUNC_CHUNK;
+            int k, e;
+
+            for (k = 0; k < nop; ++k) {
+                args[k] = dataptrs[k] + start * strides[(ndim - 1) * nop + k];
+            }
+            /* Unravel the row over the leading broadcast dimensions */
+            for (e = ndim - 2; e >= 0; --e) {
+                npy_intp coord = row % shape[e];
+
+                row /= shape[e];
+                for (k = 0; k < nop; ++k) {
+                    args[k] += coord * strides[e * nop + k];
+                }
+            }
+
+            memcpy(count, dims, (ncore_dims + 1) * sizeof(npy_intp));
+            count[0] = len - start;
+            if (count[0] > MPY_GUFUNC_CHUNK) {
+                count[0] = MPY_GUFUNC_CHUNK;
+            }
+            loop(args, count, steps, loopdata);
+        }
+    }
+}
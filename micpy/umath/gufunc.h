@@ -0,0 +1,19 @@
+#ifndef _MPY_MUFUNC_GUFUNC_H
+#define _MPY_MUFUNC_GUFUNC_H
+
+/*
+ * Runs the core loop of a generalized ufunc over all 'ndim' broadcast
+ * dimensions of 'shape' in a single offload.  'dataptrs' holds the
+ * device data of the 'nop' operands and 'strides' their strides,
+ * 'nop' entries per broadcast dimension.  'core_dims' and
+ * 'core_strides' are passed to every call of the core loop as
+ * dimensions[1:] and steps[nop:].  Must be called without the GIL.
+ */
+NPY_NO_EXPORT void
+mpy_gufunc_loop(PyUFuncGenericFunction innerloop, void *innerloopdata,
+                int device, int nop, char **dataptrs,
+                int ndim, npy_intp *shape, npy_intp *strides,
+                int ncore_dims, npy_intp *core_dims,
+                int ncore_strides, npy_intp *core_strides);
+
+#endif
@@ -0,0 +1,462 @@
+/*
+ * Lazy expression mode (micpy.lazy).
+ *
+ * While the mode is on, or when an operand is a deferred result, ufunc
+ * calls are handed to a Python hook installed by micpy/lazy.py instead
+ * of being executed.  The hook records them in an expression graph and
+ * later evaluates the graph through _lazy_execute, which runs every
+ * elementwise node of it in a single target region.
+ *
+ * The fused loop walks the output in chunks of MPY_LAZY_CHUNK elements.
+ * For each chunk the ordinary inner loops of all nodes are called one
+ * after another; intermediate results live in small per-thread chunk
+ * buffers which stay in cache, so the inputs are read from memory once
+ * and only the final result is written back.
+ *
+ * Deferred nodes hold their inputs by reference.  While any of them is
+ * pending lazy.py installs a write hook, which ufuncs call with every
+ * array they are about to write so that the nodes reading it are
+ * evaluated first.
+ */
+#include <Python.h>
+
+#define NPY_NO_DEPRECATED_API NPY_API_VERSION
+#define PY_ARRAY_UNIQUE_SYMBOL _mpy_umathmodule_ARRAY_API
+#define NO_IMPORT_ARRAY
+#define PY_UFUNC_UNIQUE_SYMBOL _mpy_umathmodule_UFUNC_API
+#define NO_IMPORT_UFUNC
+#include <numpy/npy_common.h>
+#include <numpy/arrayobject.h>
+#include <numpy/ufuncobject.h>
+#include <numpy/npy_3kcompat.h>
+
+#define PyMicArray_API_UNIQUE_NAME _mpy_umathmodule_MICARRAY_API
+#define PyMicArray_NO_IMPORT
+#include <multiarray/arrayobject.h>
+#include <multiarray/multiarray_api.h>
+#include <multiarray/mpy_common.h>
+#include <multiarray/common.h>
+
+#define _MICARRAY_UMATHMODULE
+#include "mufunc_object.h"
+#include "lazy.h"
+
+/* Elements per chunk of the fused loop */
+#define MPY_LAZY_CHUNK 2048
+#define MPY_LAZY_MAXINSTR 64
+#define MPY_LAZY_MAXNIN 3
+#define MPY_LAZY_MAXREGS (4 * MPY_LAZY_MAXINSTR)
+
+/* Register kinds */
+#define MPY_LAZY_LEAF 0
+#define MPY_LAZY_CONST 1
+#define MPY_LAZY_TEMP 2
+
+static PyObject *lazy_hook = NULL;
+static PyTypeObject *lazy_type = NULL;
+static int lazy_enabled = 0;
+/* Set while deferred nodes are pending */
+static PyObject *lazy_write_hook = NULL;
+
+/*
+ * Returns 1 if a ufunc call with these positional arguments has to go
+ * through the lazy hook.
+ */
+NPY_NO_EXPORT int
+mpy_lazy_intercepts(PyObject *args)
+{
+    Py_ssize_t i;
+
+    if (lazy_hook == NULL) {
+        return 0;
+    }
+    if (lazy_enabled) {
+        return 1;
+    }
+    for (i = 0; i < PyTuple_GET_SIZE(args); ++i) {
+        if (PyObject_TypeCheck(PyTuple_GET_ITEM(args, i), lazy_type)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Calls the hook.  It either returns the (deferred) result, or a tuple
+ * of concrete arguments the call should be executed with right away,
+ * which is passed back through 'eager_args'.
+ */
+NPY_NO_EXPORT PyObject *
+mpy_lazy_call_hook(PyUFuncObject *ufunc, PyObject *args, PyObject *kwds,
+                   PyObject **eager_args)
+{
+    PyObject *res;
+
+    *eager_args = NULL;
+    res = PyObject_CallFunctionObjArgs(lazy_hook, (PyObject *)ufunc, args,
+                                       (kwds != NULL) ? kwds : Py_None,
+                                       NULL);
+    if (res != NULL && PyTuple_CheckExact(res)) {
+        *eager_args = res;
+        return NULL;
+    }
+    return res;
+}
+
+/*
+ * Tells the write hook that a ufunc is about to write 'op'.  Returns -1
+ * with an exception set if evaluating the pending nodes failed.
+ */
+NPY_NO_EXPORT int
+mpy_lazy_written(PyObject *op)
+{
+    PyObject *hook = lazy_write_hook, *res;
+
+    if (hook == NULL) {
+        return 0;
+    }
+    /* The hook may uninstall itself */
+    Py_INCREF(hook);
+    res = PyObject_CallFunctionObjArgs(hook, op, NULL);
+    Py_DECREF(hook);
+    if (res == NULL) {
+        return -1;
+    }
+    Py_DECREF(res);
+    return 0;
+}
+
+/* _set_lazy_hook(hook, type), hook None uninstalls */
+NPY_NO_EXPORT PyObject *
+mpy_lazy_set_hook(PyObject *NPY_UNUSED(self), PyObject *args)
+{
+    PyObject *hook, *type = NULL;
+
+    if (!PyArg_ParseTuple(args, "O|O!:_set_lazy_hook", &hook,
+                          &PyType_Type, &type)) {
+        return NULL;
+    }
+
+    if (hook == Py_None) {
+        Py_CLEAR(lazy_hook);
+        Py_CLEAR(lazy_type);
+        Py_CLEAR(lazy_write_hook);
+        lazy_enabled = 0;
+        Py_RETURN_NONE;
+    }
+    if (!PyCallable_Check(hook) || type == NULL) {
+        PyErr_SetString(PyExc_TypeError,
+                "_set_lazy_hook expects a callable and a type");
+        return NULL;
+    }
+
+    Py_INCREF(hook);
+    Py_XSETREF(lazy_hook, hook);
+    Py_INCREF(type);
+    Py_XSETREF(lazy_type, (PyTypeObject *)type);
+    Py_RETURN_NONE;
+}
+
+/* _set_lazy(flag), returns the previous state */
+NPY_NO_EXPORT PyObject *
+mpy_lazy_set_enabled(PyObject *NPY_UNUSED(self), PyObject *args)
+{
+    int flag, prev = lazy_enabled;
+
+    if (!PyArg_ParseTuple(args, "i:_set_lazy", &flag)) {
+        return NULL;
+    }
+    lazy_enabled = (flag != 0);
+    return PyBool_FromLong(prev);
+}
+
+/* _set_lazy_write_hook(hook), hook None uninstalls */
+NPY_NO_EXPORT PyObject *
+mpy_lazy_set_write_hook(PyObject *NPY_UNUSED(self), PyObject *args)
+{
+    PyObject *hook;
+
+    if (!PyArg_ParseTuple(args, "O:_set_lazy_write_hook", &hook)) {
+        return NULL;
+    }
+    if (hook == Py_None) {
+        Py_CLEAR(lazy_write_hook);
+        Py_RETURN_NONE;
+    }
+    if (!PyCallable_Check(hook)) {
+        PyErr_SetString(PyExc_TypeError,
+                "_set_lazy_write_hook expects a callable");
+        return NULL;
+    }
+    Py_INCREF(hook);
+    Py_XSETREF(lazy_write_hook, hook);
+    Py_RETURN_NONE;
+}
+
+/*
+ * _lazy_execute(out, leaves, consts, const_offsets, program)
+ *
+ * Evaluates a linearized expression into 'out'.
+ *
+ * Registers are numbered leaves first, then constants, then one
+ * temporary per instruction but the last, which writes 'out'.  Leaves
+ * are C-contiguous arrays of the size of 'out' or of size one, constants
+ * are offsets of single items in the 'consts' bytes.
+ *
+ * program  - tuple of (ufunc, type_nums, input_registers), where
+ *            type_nums gives the loop types of inputs and output
+ */
+NPY_NO_EXPORT PyObject *
+mpy_lazy_execute(PyObject *NPY_UNUSED(self), PyObject *args)
+{
+    PyMicArrayObject *out;
+    PyObject *leaves, *consts, *const_offsets, *program;
+    MPY_TARGET_MIC PyUFuncGenericFunction loops[MPY_LAZY_MAXINSTR];
+    MPY_TARGET_MIC void *loopdata[MPY_LAZY_MAXINSTR];
+    int instr_nin[MPY_LAZY_MAXINSTR];
+    int instr_reg[MPY_LAZY_MAXINSTR * MPY_LAZY_MAXNIN];
+    npy_intp reg_kind[MPY_LAZY_MAXREGS], reg_addr[MPY_LAZY_MAXREGS];
+    npy_intp reg_stride[MPY_LAZY_MAXREGS];
+    int reg_type[MPY_LAZY_MAXREGS];
+    int i, j, k, nleaves, nconsts, ninstr, nregs, device, failed = 0;
+    npy_intp size, tempbytes = 0, nconstbytes, outstride;
+    char *constdata, *outdata, noconst[1];
+
+    NPY_BEGIN_THREADS_DEF;
+
+    if (!PyArg_ParseTuple(args, "O!O!O!O!O!:_lazy_execute",
+                          &PyMicArray_Type, &out,
+                          &PyTuple_Type, &leaves,
+                          &PyBytes_Type, &consts,
+                          &PyTuple_Type, &const_offsets,
+                          &PyTuple_Type, &program)) {
+        return NULL;
+    }
+
+    nleaves = (int)PyTuple_GET_SIZE(leaves);
+    nconsts = (int)PyTuple_GET_SIZE(const_offsets);
+    ninstr = (int)PyTuple_GET_SIZE(program);
+    nregs = nleaves + nconsts + ninstr - 1;
+    if (ninstr < 1 || ninstr > MPY_LAZY_MAXINSTR ||
+            nregs > MPY_LAZY_MAXREGS) {
+        PyErr_SetString(PyExc_ValueError,
+                "expression too large to be fused");
+        return NULL;
+    }
+    if (!PyMicArray_IS_C_CONTIGUOUS(out) || !PyMicArray_ISWRITEABLE(out)) {
+        PyErr_SetString(PyExc_ValueError,
+                "output must be a writeable contiguous array");
+        return NULL;
+    }
+
+    size = PyMicArray_SIZE(out);
+    device = PyMicArray_DEVICE(out);
+    outdata = PyMicArray_DATA(out);
+    outstride = PyMicArray_ITEMSIZE(out);
+    nconstbytes = PyBytes_GET_SIZE(consts);
+    constdata = PyBytes_AS_STRING(consts);
+
+    /* Leaves */
+    for (i = 0; i < nleaves; ++i) {
+        PyObject *leaf = PyTuple_GET_ITEM(leaves, i);
+        PyMicArrayObject *arr = (PyMicArrayObject *)leaf;
+
+        if (!PyMicArray_Check(leaf) || PyMicArray_DEVICE(arr) != device ||
+                !PyMicArray_IS_C_CONTIGUOUS(arr) ||
+                (PyMicArray_SIZE(arr) != size && PyMicArray_SIZE(arr) != 1)) {
+            PyErr_SetString(PyExc_ValueError,
+                    "fused operands must be contiguous arrays of the "
+                    "result size on the result device");
+            return NULL;
+        }
+        reg_kind[i] = MPY_LAZY_LEAF;
+        reg_addr[i] = (npy_intp)PyMicArray_DATA(arr);
+        reg_stride[i] = (PyMicArray_SIZE(arr) == 1) ?
+                                    0 : PyMicArray_ITEMSIZE(arr);
+        reg_type[i] = PyMicArray_TYPE(arr);
+    }
+
+    /* Constants */
+    for (i = 0; i < nconsts; ++i) {
+        npy_intp offset = PyInt_AsSsize_t(PyTuple_GET_ITEM(const_offsets, i));
+
+        if (error_converting(offset)) {
+            return NULL;
+        }
+        if (offset < 0 || offset >= nconstbytes) {
+            PyErr_SetString(PyExc_ValueError, "constant offset out of range");
+            return NULL;
+        }
+        reg_kind[nleaves + i] = MPY_LAZY_CONST;
+        reg_addr[nleaves + i] = offset;
+        reg_stride[nleaves + i] = 0;
+        reg_type[nleaves + i] = NPY_NOTYPE;
+    }
+
+    /* Instructions */
+    for (k = 0; k < ninstr; ++k) {
+        PyObject *instr = PyTuple_GET_ITEM(program, k);
+        PyObject *type_nums, *regs;
+        PyUFuncObject *ufunc;
+        PyArray_Descr *dtypes[MPY_LAZY_MAXNIN + 1];
+        int needs_api = 0, nin, out_type, ret;
+
+        if (!PyArg_ParseTuple(instr, "O!O!O!:_lazy_execute",
+                              &PyMUFunc_Type, &ufunc,
+                              &PyTuple_Type, &type_nums,
+                              &PyTuple_Type, &regs)) {
+            return NULL;
+        }
+        nin = ufunc->nin;
+        if (ufunc->nout != 1 || nin > MPY_LAZY_MAXNIN ||
+                ufunc->core_enabled ||
+                PyTuple_GET_SIZE(type_nums) != nin + 1 ||
+                PyTuple_GET_SIZE(regs) != nin) {
+            PyErr_Format(PyExc_ValueError,
+                    "ufunc '%s' can't be fused", ufunc->name);
+            return NULL;
+        }
+
+        for (j = 0; j < nin + 1; ++j) {
+            int type_num = (int)PyInt_AsLong(PyTuple_GET_ITEM(type_nums, j));
+            if (error_converting(type_num) ||
+                    (dtypes[j] = PyArray_DescrFromType(type_num)) == NULL) {
+                while (--j >= 0) {
+                    Py_DECREF(dtypes[j]);
+                }
+                return NULL;
+            }
+        }
+        out_type = dtypes[nin]->type_num;
+
+        ret = ufunc->legacy_inner_loop_selector(ufunc, dtypes,
+                            &loops[k], &loopdata[k], &needs_api);
+        for (j = 0; j < nin; ++j) {
+            int r = (int)PyInt_AsLong(PyTuple_GET_ITEM(regs, j));
+            if (ret == 0 && (r < 0 || r >= nleaves + nconsts + k ||
+                    (reg_type[r] != NPY_NOTYPE &&
+                     reg_type[r] != dtypes[j]->type_num))) {
+                PyErr_SetString(PyExc_ValueError,
+                        "invalid register in fused expression");
+                ret = -1;
+            }
+            instr_reg[k * MPY_LAZY_MAXNIN + j] = r;
+        }
+        if (ret == 0 && k == ninstr - 1 && out_type != PyMicArray_TYPE(out)) {
+            PyErr_SetString(PyExc_ValueError,
+                    "fused expression doesn't match the output type");
+            ret = -1;
+        }
+        if (ret == 0 && k < ninstr - 1) {
+            i = nleaves + nconsts + k;
+            reg_kind[i] = MPY_LAZY_TEMP;
+            reg_addr[i] = tempbytes;
+            reg_stride[i] = dtypes[nin]->elsize;
+            reg_type[i] = out_type;
+            /* Keep every chunk buffer cache line aligned */
+            tempbytes += (MPY_LAZY_CHUNK * dtypes[nin]->elsize + 63) & ~63;
+        }
+        for (j = 0; j < nin + 1; ++j) {
+            Py_DECREF(dtypes[j]);
+        }
+        if (ret < 0) {
+            return NULL;
+        }
+        if (needs_api || loopdata[k] == PyUFunc_SetUsesArraysAsData) {
+            PyErr_Format(PyExc_ValueError,
+                    "ufunc '%s' can't be fused", ufunc->name);
+            return NULL;
+        }
+        instr_nin[k] = nin;
+    }
+
+    if (size == 0) {
+        Py_RETURN_NONE;
+    }
+    if (nconstbytes == 0) {
+        constdata = noconst;
+        nconstbytes = 1;
+    }
+
+    NPY_BEGIN_THREADS;
+
+#pragma omp target device(device) \
+                   map(to: loops[0:ninstr], loopdata[0:ninstr], \
+                           instr_nin[0:ninstr], \
+                           instr_reg[0:ninstr*MPY_LAZY_MAXNIN], \
+                           reg_kind[0:nregs], reg_addr[0:nregs], \
+                           reg_stride[0:nregs], constdata[0:nconstbytes], \
+                           outdata, outstride, size, ninstr, tempbytes, \
+                           nleaves, nconsts) \
+                   map(tofrom: failed)
+    {
+        npy_intp nchunks = (size + MPY_LAZY_CHUNK - 1) / MPY_LAZY_CHUNK;
+
+        #pragma omp parallel
+        {
+            char *temps = (tempbytes > 0) ? malloc(tempbytes) : NULL;
+            npy_intp c;
+
+            if (tempbytes > 0 && temps == NULL) {
+                #pragma omp atomic write
+                failed = 1;
+            }
+
+            #pragma omp for schedule(static)
+            for (c = 0; c < nchunks; ++c) {
+                npy_intp start = c * MPY_LAZY_CHUNK;
+                npy_intp count = size - start;
+                int ki, ji;
+
+                if (count > MPY_LAZY_CHUNK) {
+                    count = MPY_LAZY_CHUNK;
+                }
+                if (tempbytes > 0 && temps == NULL) {
+                    continue;
+                }
+
+                for (ki = 0; ki < ninstr; ++ki) {
+                    char *ptrs[MPY_LAZY_MAXNIN + 1];
+                    npy_intp strides[MPY_LAZY_MAXNIN + 1];
+                    int n = instr_nin[ki];
+
+                    for (ji = 0; ji < n; ++ji) {
+                        int r = instr_reg[ki * MPY_LAZY_MAXNIN + ji];
+                        switch (reg_kind[r]) {
+                            case MPY_LAZY_LEAF:
+                                ptrs[ji] = (char *)reg_addr[r] +
+                                                start * reg_stride[r];
+                                break;
+                            case MPY_LAZY_CONST:
+                                ptrs[ji] = constdata + reg_addr[r];
+                                break;
+                            default:
+                                ptrs[ji] = temps + reg_addr[r];
+                                break;
+                        }
+                        strides[ji] = reg_stride[r];
+                    }
+                    if (ki == ninstr - 1) {
+                        ptrs[n] = outdata + start * outstride;
+                        strides[n] = outstride;
+                    }
+                    else {
+                        int r = nleaves + nconsts + ki;
+                        ptrs[n] = temps + reg_addr[r];
+                        strides[n] = reg_stride[r];
+                    }
+                    loops[ki](ptrs, &count, strides, loopdata[ki]);
+                }
+            }
+
+            free(temps);
+        }
+    }
+
+    NPY_END_THREADS;
+
+    if (failed) {
+        return PyErr_NoMemory();
+    }
+    Py_RETURN_NONE;
+}
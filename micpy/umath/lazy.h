@@ -0,0 +1,30 @@
+#ifndef _MPY_MUFUNC_LAZY_H
+#define _MPY_MUFUNC_LAZY_H
+
+/*
+ * Hooks of the lazy expression mode, the graph itself is built by
+ * micpy/lazy.py.
+ */
+NPY_NO_EXPORT int
+mpy_lazy_intercepts(PyObject *args);
+
+NPY_NO_EXPORT PyObject *
+mpy_lazy_call_hook(PyUFuncObject *ufunc, PyObject *args, PyObject *kwds,
+                   PyObject **eager_args);
+
+NPY_NO_EXPORT int
+mpy_lazy_written(PyObject *op);
+
+NPY_NO_EXPORT PyObject *
+mpy_lazy_set_hook(PyObject *NPY_UNUSED(self), PyObject *args);
+
+NPY_NO_EXPORT PyObject *
+mpy_lazy_set_enabled(PyObject *NPY_UNUSED(self), PyObject *args);
+
+NPY_NO_EXPORT PyObject *
+mpy_lazy_set_write_hook(PyObject *NPY_UNUSED(self), PyObject *args);
+
+NPY_NO_EXPORT PyObject *
+mpy_lazy_execute(PyObject *NPY_UNUSED(self), PyObject *args);
+
+#endif
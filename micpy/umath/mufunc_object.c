@@ -51,10 +51,21 @@
 #include "mufunc_object.h"
 #include "output_creators.h"
 #include "reduction.h"
+#include "dispatch.h"
+#include "lazy.h"
+#include "scan.h"
+#include "segment.h"
+#include "scatter.h"
+#include "outer.h"
+#include "gufunc.h"
+#include "typecache.h"
 
 /* Some useful macros */
 #define CPU_DEVICE (omp_get_initial_device())
 
+/* npy_longlongs holding a scalar operand passed by value */
+#define MPY_SCALAR_BUFSIZE 4
+
 #define PyMicArray_TRIVIAL_PAIR_ITERATION_STRIDE(size, arr) ( \
                         size == 1 ? 0 : ((PyMicArray_NDIM(arr) == 1) ? \
                                           PyMicArray_STRIDE(arr, 0) : \
@@ -170,6 +181,39 @@ _on_same_device(PyUFuncObject *ufunc, PyMicArrayObject **op)
     return 0;
 }
 
+/*
+ * Waits for the stream transfers still writing the operands, or still
+ * reading the outputs
+ */
+static void
+_fence_operands(PyUFuncObject *ufunc, PyMicArrayObject **op)
+{
+    int i, nop = ufunc->nin + ufunc->nout;
+
+    for (i = 0; i < nop; ++i) {
+        if (op[i] != NULL) {
+            PyMicStream_Fence((PyObject *)op[i], i >= ufunc->nin);
+        }
+    }
+}
+
+/*
+ * Evaluates the pending lazy expressions which read one of the given
+ * outputs, before they are overwritten
+ */
+static int
+_outputs_written(PyUFuncObject *ufunc, PyMicArrayObject **op)
+{
+    int i, nop = ufunc->nin + ufunc->nout;
+
+    for (i = ufunc->nin; i < nop; ++i) {
+        if (op[i] != NULL && mpy_lazy_written((PyObject *)op[i]) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
 /*
  * fpstatus is the ufunc_formatted hardware status
  * errmask is the handling mask specified by the user.
@@ -819,6 +863,17 @@ get_ufunc_arguments(PyUFuncObject *ufunc,
                         *out_subok = (value == Py_True);
                         bad_arg = 0;
                     }
+                    /*
+                     * Orders the call after the transfers queued on a
+                     * stream, the loop itself still runs synchronously
+                     */
+                    else if (strcmp(str, "stream") == 0) {
+                        if (value != Py_None &&
+                                PyMicStream_Synchronize(value) < 0) {
+                            goto fail;
+                        }
+                        bad_arg = 0;
+                    }
                     break;
                 case 'w':
                     /*
@@ -927,14 +982,15 @@ check_for_trivial_loop(PyUFuncObject *ufunc,
 }
 
 static void
-trivial_two_operand_loop(PyMicArrayObject **op,
+trivial_two_operand_loop(PyUFuncObject *ufunc,
+                    PyMicArrayObject **op,
                     PyUFuncGenericFunction innerloop,
                     void *innerloopdata)
 {
     void *data0, *data1;
     npy_intp stride0, stride1;
     npy_intp count;
-    int needs_api, device;
+    int needs_api, device, on_host;
     MPY_TARGET_MIC PyUFuncGenericFunction offloop = innerloop;
     MPY_TARGET_MIC void (*offdata)(void) = innerloopdata;
 
@@ -951,10 +1007,22 @@ trivial_two_operand_loop(PyMicArrayObject **op,
                                               stride0, stride1);
     NPY_UF_DBG_PRINT1("two operand loop count %d\n", (int)count);
 
+    on_host = !needs_api && mpy_dispatch_use_host(ufunc, 1, 2, op, count);
+
     if (!needs_api) {
         NPY_BEGIN_THREADS_THRESHOLDED(count);
     }
 
+    if (on_host) {
+        char *data[] = {data0, data1};
+        npy_intp stride[] = {stride0, stride1};
+        if (mpy_dispatch_host_loop(innerloop, innerloopdata, 1, 2, op,
+                                   data, stride, count) == 0) {
+            NPY_END_THREADS;
+            return;
+        }
+    }
+
 #pragma offload target(mic:device) in(offloop, offdata, count,\
                                       data0, data1,\
                                       stride0, stride1)
@@ -968,14 +1036,15 @@ trivial_two_operand_loop(PyMicArrayObject **op,
 }
 
 static void
-trivial_three_operand_loop(PyMicArrayObject **op,
+trivial_three_operand_loop(PyUFuncObject *ufunc,
+                    PyMicArrayObject **op,
                     PyUFuncGenericFunction innerloop,
                     void *innerloopdata)
 {
     void *data0, *data1, *data2;
     npy_intp stride0, stride1, stride2;
     npy_intp count;
-    int needs_api, device;
+    int needs_api, device, on_host;
     MPY_TARGET_MIC PyUFuncGenericFunction offloop = innerloop;
     MPY_TARGET_MIC void (*offdata)(void) = innerloopdata;
 
@@ -993,10 +1062,22 @@ trivial_three_operand_loop(PyMicArrayObject **op,
 
     NPY_UF_DBG_PRINT1("three operand loop count %d\n", (int)count);
 
+    on_host = !needs_api && mpy_dispatch_use_host(ufunc, 2, 3, op, count);
+
     if (!needs_api) {
         NPY_BEGIN_THREADS_THRESHOLDED(count);
     }
 
+    if (on_host) {
+        char *data[] = {data0, data1, data2};
+        npy_intp stride[] = {stride0, stride1, stride2};
+        if (mpy_dispatch_host_loop(innerloop, innerloopdata, 2, 3, op,
+                                   data, stride, count) == 0) {
+            NPY_END_THREADS;
+            return;
+        }
+    }
+
 #pragma offload target(mic:device) in(offloop, offdata, count,\
                                       data0, data1, data2,\
                                       stride0, stride1, stride2)
@@ -1009,7 +1090,68 @@ trivial_three_operand_loop(PyMicArrayObject **op,
     NPY_END_THREADS;
 }
 
+/*
+ * Binary loop over the device array 'arr' and a host scalar, which is
+ * shipped by value in the offload and read with a zero stride, so the
+ * inner loops take their scalar operand kernels.  'value' is operand
+ * 'scalar_idx' (0 or 1) and holds the scalar in the loop dtype.
+ */
+static void
+trivial_scalar_loop(PyMicArrayObject *arr, int scalar_idx,
+                    npy_longlong *value, PyMicArrayObject *out,
+                    PyUFuncGenericFunction innerloop,
+                    void *innerloopdata)
+{
+    void *data0, *data2;
+    npy_intp stride0, stride2;
+    npy_intp count;
+    npy_longlong scalar[MPY_SCALAR_BUFSIZE];
+    int device, idx = scalar_idx;
+    MPY_TARGET_MIC PyUFuncGenericFunction offloop = innerloop;
+    MPY_TARGET_MIC void (*offdata)(void) = innerloopdata;
+
+    NPY_BEGIN_THREADS_DEF;
+
+    memcpy(scalar, value, sizeof(scalar));
+    device = PyMicArray_DEVICE(arr);
+    PyMicArray_PREPARE_TRIVIAL_PAIR_ITERATION(arr, out,
+                                              count,
+                                              data0, data2,
+                                              stride0, stride2);
+
+    NPY_UF_DBG_PRINT1("scalar operand loop count %d\n", (int)count);
+
+    NPY_BEGIN_THREADS_THRESHOLDED(count);
+
+#pragma offload target(mic:device) in(offloop, offdata, count, idx,\
+                                      data0, data2, scalar,\
+                                      stride0, stride2)
+    {
+        char *data[3];
+        npy_intp stride[3];
+
+        data[idx] = data0;
+        data[1 - idx] = (char *)scalar;
+        data[2] = data2;
+        stride[idx] = stride0;
+        stride[1 - idx] = 0;
+        stride[2] = stride2;
+        offloop(data, &count, stride, offdata);
+    }
+
+    NPY_END_THREADS;
+}
+
 
+/*
+ * Executes the inner loop through an MpyIter.
+ *
+ * When device_iterate is set, no operand needs casting or alignment
+ * buffering (trivial_loop_ok), so the iterator is built unbuffered and,
+ * if its iternext can run on the device, the whole iteration is done
+ * by the mirrored iterator inside a single target region instead of
+ * one offload per inner chunk.
+ */
 static int
 iterator_loop(PyUFuncObject *ufunc,
                     PyMicArrayObject **op,
@@ -1019,7 +1161,8 @@ iterator_loop(PyUFuncObject *ufunc,
                     PyObject **arr_prep,
                     PyObject *arr_prep_args,
                     PyUFuncGenericFunction innerloop,
-                    void *innerloopdata)
+                    void *innerloopdata,
+                    int device_iterate)
 {
     npy_intp i, nin = ufunc->nin, nout = ufunc->nout;
     npy_intp nop = nin + nout;
@@ -1033,6 +1176,7 @@ iterator_loop(PyUFuncObject *ufunc,
     npy_intp *dataptr;
     npy_intp *stride;
     npy_intp *count_ptr;
+    MpyIter *offiter;
     int device;
 
     PyMicArrayObject **op_it;
@@ -1068,11 +1212,18 @@ iterator_loop(PyUFuncObject *ufunc,
                  NPY_ITER_EXTERNAL_LOOP |
                  NPY_ITER_REFS_OK |
                  NPY_ITER_ZEROSIZE_OK |
-                 NPY_ITER_BUFFERED |
-                 NPY_ITER_GROWINNER |
-                 NPY_ITER_DELAY_BUFALLOC |
                  NPY_ITER_COPY_IF_OVERLAP;
 
+    /*
+     * Buffered iternext functions copy through host-side transfer
+     * functions and can't be offloaded, so only buffer when needed.
+     */
+    if (!device_iterate) {
+        iter_flags |= NPY_ITER_BUFFERED |
+                      NPY_ITER_GROWINNER |
+                      NPY_ITER_DELAY_BUFALLOC;
+    }
+
     /*
      * Allocate the iterator.  Because the types of the inputs
      * were already checked, we use the casting rule 'unsafe' which
@@ -1135,22 +1286,45 @@ iterator_loop(PyUFuncObject *ufunc,
             MpyIter_Deallocate(iter);
             return -1;
         }
-        dataptr = (npy_intp *) MpyIter_GetDataPtrArray(iter);
-        stride = MpyIter_GetInnerStrideArray(iter);
-        count_ptr = MpyIter_GetInnerLoopSizePtr(iter);
         device = MpyIter_GetDevice(iter);
 
-        MPY_BEGIN_THREADS_NDITER(iter);
+        if (device_iterate && MpyIter_CanOffloadIternext(iternext)) {
+            /* These point into the mirrored iterator on the device */
+            offiter = MpyIter_GetOffIter(iter);
+            dataptr = MpyIter_GetOffDataPtrArray(iter);
+            stride = MpyIter_GetOffInnerStrideArray(iter);
+            count_ptr = MpyIter_GetOffInnerLoopSizePtr(iter);
+
+            MPY_BEGIN_THREADS_NDITER(iter);
+
+            NPY_UF_DBG_PRINT("device resident iterator loop\n");
+#pragma omp target device(device) map(to: offloop, offdata, iternext,\
+                                          offiter, dataptr, stride, count_ptr)
+            {
+                do {
+                    offloop((char **)dataptr, count_ptr, stride, offdata);
+                } while (iternext(offiter));
+            }
 
-        /* Execute the loop */
-        do {
-            //NPY_UF_DBG_PRINT1("iterator loop count %d\n", (int)*count_ptr);
+            NPY_END_THREADS;
+        }
+        else {
+            dataptr = (npy_intp *) MpyIter_GetDataPtrArray(iter);
+            stride = MpyIter_GetInnerStrideArray(iter);
+            count_ptr = MpyIter_GetInnerLoopSizePtr(iter);
+
+            MPY_BEGIN_THREADS_NDITER(iter);
+
+            /* Execute the loop */
+            do {
+                //NPY_UF_DBG_PRINT1("iterator loop count %d\n", (int)*count_ptr);
 #pragma omp target device(device) map(to: offloop, offdata, count_ptr[0:1],\
                                           dataptr[0:nop], stride[0:nop])
-            offloop((char **)dataptr, count_ptr, stride, offdata);
-        } while (iternext(iter));
+                offloop((char **)dataptr, count_ptr, stride, offdata);
+            } while (iternext(iter));
 
-        NPY_END_THREADS;
+            NPY_END_THREADS;
+        }
     }
 
     MpyIter_Deallocate(iter);
@@ -1176,17 +1350,12 @@ execute_legacy_ufunc_loop(PyUFuncObject *ufunc,
                     NPY_ORDER order,
                     npy_intp buffersize,
                     PyObject **arr_prep,
-                    PyObject *arr_prep_args)
+                    PyObject *arr_prep_args,
+                    PyUFuncGenericFunction innerloop,
+                    void *innerloopdata)
 {
     npy_intp nin = ufunc->nin, nout = ufunc->nout;
-    PyUFuncGenericFunction innerloop;
-    void *innerloopdata;
-    int needs_api = 0;
 
-    if (ufunc->legacy_inner_loop_selector(ufunc, dtypes,
-                    &innerloop, &innerloopdata, &needs_api) < 0) {
-        return -1;
-    }
     /* If the loop wants the arrays, provide them. */
     if (_does_loop_use_arrays(innerloopdata)) {
         innerloopdata = (void*)op;
@@ -1214,7 +1383,7 @@ execute_legacy_ufunc_loop(PyUFuncObject *ufunc,
                 }
 
                 NPY_UF_DBG_PRINT("trivial 1 input with allocated output\n");
-                trivial_two_operand_loop(op, innerloop, innerloopdata);
+                trivial_two_operand_loop(ufunc, op, innerloop, innerloopdata);
 
                 return 0;
             }
@@ -1225,7 +1394,7 @@ execute_legacy_ufunc_loop(PyUFuncObject *ufunc,
                                                            PyArray_TRIVIALLY_ITERABLE_OP_NOREAD)) {
 
                 NPY_UF_DBG_PRINT("trivial 1 input\n");
-                trivial_two_operand_loop(op, innerloop, innerloopdata);
+                trivial_two_operand_loop(ufunc, op, innerloop, innerloopdata);
 
                 return 0;
             }
@@ -1263,7 +1432,7 @@ execute_legacy_ufunc_loop(PyUFuncObject *ufunc,
                 }
 
                 NPY_UF_DBG_PRINT("trivial 2 input with allocated output\n");
-                trivial_three_operand_loop(op, innerloop, innerloopdata);
+                trivial_three_operand_loop(ufunc, op, innerloop, innerloopdata);
 
                 return 0;
             }
@@ -1276,7 +1445,7 @@ execute_legacy_ufunc_loop(PyUFuncObject *ufunc,
                                                          PyArray_TRIVIALLY_ITERABLE_OP_NOREAD)) {
 
                 NPY_UF_DBG_PRINT("trivial 2 input\n");
-                trivial_three_operand_loop(op, innerloop, innerloopdata);
+                trivial_three_operand_loop(ufunc, op, innerloop, innerloopdata);
 
                 return 0;
             }
@@ -1291,7 +1460,7 @@ execute_legacy_ufunc_loop(PyUFuncObject *ufunc,
     NPY_UF_DBG_PRINT("iterator loop\n");
     if (iterator_loop(ufunc, op, dtypes, order,
                     buffersize, arr_prep, arr_prep_args,
-                    innerloop, innerloopdata) < 0) {
+                    innerloop, innerloopdata, trivial_loop_ok) < 0) {
         return -1;
     }
 
@@ -1612,6 +1781,11 @@ PyMUFunc_GeneralizedFunction(PyUFuncObject *ufunc,
     PyArrayObject *op_npy[NPY_MAXARGS];
     int device;
 
+    /* Shape and per-operand strides of the broadcast dimensions */
+    npy_intp outer_shape[NPY_MAXDIMS];
+    npy_intp outer_strides[NPY_MAXDIMS * NPY_MAXARGS];
+    char *dataptrs[NPY_MAXARGS];
+
     /* These parameters come from extobj= or from a TLS global */
     int buffersize = 0, errormask = 0;
 
@@ -1674,6 +1848,11 @@ PyMUFunc_GeneralizedFunction(PyUFuncObject *ufunc,
     if (retval < 0) {
         goto fail;
     }
+    _fence_operands(ufunc, op);
+    retval = _outputs_written(ufunc, op);
+    if (retval < 0) {
+        goto fail;
+    }
 
     /*
      * Figure out the number of iteration dimensions, which
@@ -1961,16 +2140,39 @@ PyMUFunc_GeneralizedFunction(PyUFuncObject *ufunc,
     /* Find destination device */
     device = PyMUFunc_GetCommonDevice(nin, op);
 
-    /* Allocate output array */
+    /* Broadcast the non-core dimensions of the given operands */
+    for (idim = 0; idim < broadcast_ndim; ++idim) {
+        outer_shape[idim] = 1;
+        for (i = 0; i < nop; ++i) {
+            int axis = op_axes_arrays[i][idim];
+            if (op[i] != NULL && axis >= 0 &&
+                    PyMicArray_DIM(op[i], axis) != 1) {
+                outer_shape[idim] = PyMicArray_DIM(op[i], axis);
+            }
+        }
+    }
+
+    /* Allocate the missing outputs, followed by their core dimensions */
     for (i = nin; i < nop; ++i) {
-        PyMicArrayObject *tmp;
         if (op[i] == NULL) {
-            tmp = PyMUFunc_CreateArrayBroadcast(nin, op, dtypes[i]);
-            if (tmp == NULL) {
+            npy_intp shape[NPY_MAXDIMS];
+            int dim_offset = ufunc->core_offsets[i];
+            int num_dims = ufunc->core_num_dims[i];
+
+            memcpy(shape, outer_shape, broadcast_ndim * sizeof(npy_intp));
+            for (idim = 0; idim < num_dims; ++idim) {
+                shape[broadcast_ndim + idim] = core_dim_sizes[
+                                    ufunc->core_dim_ixs[dim_offset + idim]];
+            }
+            Py_INCREF(dtypes[i]);
+            op[i] = (PyMicArrayObject *)PyMicArray_NewFromDescr(device,
+                                    &PyMicArray_Type, dtypes[i],
+                                    broadcast_ndim + num_dims, shape,
+                                    NULL, NULL, 0, NULL);
+            if (op[i] == NULL) {
+                retval = -1;
                 goto fail;
             }
-
-            op[i] = tmp;
         }
     }
 
@@ -2052,36 +2254,23 @@ PyMUFunc_GeneralizedFunction(PyUFuncObject *ufunc,
         total_problem_size = 1000;
     }
 
-    /* Remove all the core output dimensions from the iterator */
-    for (i = broadcast_ndim; i < iter_ndim; ++i) {
-        if (NpyIter_RemoveAxis(iter, broadcast_ndim) != NPY_SUCCEED) {
-            retval = -1;
-            goto fail;
-        }
-    }
-    if (NpyIter_RemoveMultiIndex(iter) != NPY_SUCCEED) {
-        retval = -1;
-        goto fail;
-    }
-    if (NpyIter_EnableExternalLoop(iter) != NPY_SUCCEED) {
-        retval = -1;
-        goto fail;
-    }
-
     /*
-     * The first nop strides are for the inner loop (but only can
-     * copy them after removing the core axes
+     * The device walks the broadcast dimensions itself, so collect
+     * their strides, zero where an operand is broadcast.
      */
-    memcpy(inner_strides, NpyIter_GetInnerStrideArray(iter),
-                                    NPY_SIZEOF_INTP * nop);
-
-#if 0
-    printf("strides: ");
-    for (i = 0; i < nop+core_dim_ixs_size; ++i) {
-        printf("%d ", (int)inner_strides[i]);
+    for (i = 0; i < nop; ++i) {
+        dataptrs[i] = PyMicArray_DATA(op[i]);
+        for (idim = 0; idim < broadcast_ndim; ++idim) {
+            int axis = op_axes_arrays[i][idim];
+            if (axis >= 0 && PyMicArray_DIM(op[i], axis) != 1) {
+                outer_strides[idim * nop + i] =
+                                    PyMicArray_STRIDE(op[i], axis);
+            }
+            else {
+                outer_strides[idim * nop + i] = 0;
+            }
+        }
     }
-    printf("\n");
-#endif
 
     /* Start with the floating-point exception flags cleared */
     PyUFunc_clearfperr();
@@ -2089,33 +2278,16 @@ PyMUFunc_GeneralizedFunction(PyUFuncObject *ufunc,
     NPY_UF_DBG_PRINT("Executing inner loop\n");
 
     if (NpyIter_GetIterSize(iter) != 0) {
-        /* Do the ufunc loop */
-        NpyIter_IterNextFunc *iternext;
-        char **dataptr;
-        npy_intp *count_ptr;
+        /* Do the ufunc loop, all of it in one offload */
         NPY_BEGIN_THREADS_DEF;
 
-        /* Get the variables needed for the loop */
-        iternext = NpyIter_GetIterNext(iter, NULL);
-        if (iternext == NULL) {
-            retval = -1;
-            goto fail;
-        }
-        dataptr = NpyIter_GetDataPtrArray(iter);
-        count_ptr = NpyIter_GetInnerLoopSizePtr(iter);
-
         if (!needs_api && !NpyIter_IterationNeedsAPI(iter)) {
             NPY_BEGIN_THREADS_THRESHOLDED(total_problem_size);
         }
-        do {
-            inner_dimensions[0] = *count_ptr;
-#pragma omp target device(device) \
-            map(to: innerloop, innerloopdata,\
-                    inner_dimensions[0:NPY_MAXDIMS+1],\
-                    inner_strides[0:nop+core_dim_ixs_size])
-            innerloop(NULL, inner_dimensions, inner_strides, innerloopdata);
-        } while (iternext(iter));
-
+        mpy_gufunc_loop(innerloop, innerloopdata, device, nop, dataptrs,
+                        broadcast_ndim, outer_shape, outer_strides,
+                        ufunc->core_num_dim_ix, core_dim_sizes,
+                        core_dim_ixs_size, inner_strides + nop);
         if (!needs_api && !NpyIter_IterationNeedsAPI(iter)) {
             NPY_END_THREADS;
         }
@@ -2233,6 +2405,11 @@ PyMUFunc_GenericFunction(PyUFuncObject *ufunc,
 
     int trivial_loop_ok = 0;
 
+    /* The selected inner loop */
+    PyUFuncGenericFunction innerloop = NULL;
+    void *innerloopdata = NULL;
+    int needs_api = 0, use_typecache;
+
     NPY_ORDER order = NPY_KEEPORDER;
     /* Use the default assignment casting rule */
     NPY_CASTING casting = NPY_DEFAULT_ASSIGN_CASTING;
@@ -2279,6 +2456,11 @@ PyMUFunc_GenericFunction(PyUFuncObject *ufunc,
         PyErr_SetString(PyExc_ValueError, "All array have to be on the same device");
         goto fail;
     }
+    _fence_operands(ufunc, op);
+    retval = _outputs_written(ufunc, op);
+    if (retval < 0) {
+        goto fail;
+    }
 
     /*
      * Use the masked loop if a wheremask was specified.
@@ -2295,14 +2477,31 @@ PyMUFunc_GenericFunction(PyUFuncObject *ufunc,
 
     NPY_UF_DBG_PRINT("Finding inner loop\n");
 
-    /* Work around to live with numpy type_resolver */
-    ufunc_pre_typeresolver(ufunc, op, scal_ptrs, scal_buffer, 4);
+    /* Plain calls may have been resolved before */
+    use_typecache = (type_tup == NULL && !need_fancy);
+    if (!use_typecache || !mpy_typecache_lookup(ufunc, casting, op, dtypes,
+                                            &innerloop, &innerloopdata)) {
+        /* Work around to live with numpy type_resolver */
+        ufunc_pre_typeresolver(ufunc, op, scal_ptrs, scal_buffer, 4);
+
+        retval = ufunc->type_resolver(ufunc, casting,
+                                (PyArrayObject **)op, type_tup, dtypes);
+        ufunc_post_typeresolver(ufunc, op, scal_ptrs);
+        if (retval < 0) {
+            goto fail;
+        }
 
-    retval = ufunc->type_resolver(ufunc, casting,
-                            (PyArrayObject **)op, type_tup, dtypes);
-    ufunc_post_typeresolver(ufunc, op, scal_ptrs);
-    if (retval < 0) {
-        goto fail;
+        if (!need_fancy) {
+            retval = ufunc->legacy_inner_loop_selector(ufunc, dtypes,
+                                &innerloop, &innerloopdata, &needs_api);
+            if (retval < 0) {
+                goto fail;
+            }
+            if (use_typecache) {
+                mpy_typecache_store(ufunc, casting, op, dtypes,
+                                    innerloop, innerloopdata);
+            }
+        }
     }
 
     /* Only do the trivial loop check for the unmasked version. */
@@ -2353,7 +2552,8 @@ PyMUFunc_GenericFunction(PyUFuncObject *ufunc,
 
         retval = execute_legacy_ufunc_loop(ufunc, trivial_loop_ok,
                             op, dtypes, order,
-                            buffersize, arr_prep, arr_prep_args);
+                            buffersize, arr_prep, arr_prep_args,
+                            innerloop, innerloopdata);
     }
     if (retval < 0) {
         goto fail;
@@ -2803,8 +3003,19 @@ static PyMicArrayObject *
 PyMUFunc_Accumulate(PyUFuncObject *ufunc, PyMicArrayObject *arr, PyMicArrayObject *out,
                    int axis, int otype)
 {
-   /* TODO:implement this */
-   return NULL;
+    PyArray_Descr *dtype;
+    PyMicArrayObject *result;
+
+    NPY_UF_DBG_PRINT1("\nEvaluating ufunc %s.accumulate\n",
+                      _get_ufunc_name(ufunc));
+
+    dtype = PyArray_DescrFromType(otype);
+    if (dtype == NULL) {
+        return NULL;
+    }
+    result = mpy_scan_accumulate(ufunc, arr, out, axis, dtype);
+    Py_DECREF(dtype);
+    return result;
 }
 
 /*
@@ -2830,8 +3041,19 @@ static PyMicArrayObject *
 PyMUFunc_Reduceat(PyUFuncObject *ufunc, PyMicArrayObject *arr, PyArrayObject *ind,
                  PyMicArrayObject *out, int axis, int otype)
 {
-    //TODO: Implement this
-    return NULL;
+    PyArray_Descr *dtype;
+    PyMicArrayObject *result;
+
+    NPY_UF_DBG_PRINT1("\nEvaluating ufunc %s.reduceat\n",
+                      _get_ufunc_name(ufunc));
+
+    dtype = PyArray_DescrFromType(otype);
+    if (dtype == NULL) {
+        return NULL;
+    }
+    result = mpy_segment_reduceat(ufunc, arr, ind, out, axis, dtype);
+    Py_DECREF(dtype);
+    return result;
 }
 
 
@@ -2926,7 +3148,7 @@ PyMUFunc_GenericReduction(PyUFuncObject *ufunc, PyObject *args,
                                         &op,
                                         &axes_in,
                                         PyArray_DescrConverter2, &otype,
-                                        PyArray_OutputConverter, &out,
+                                        PyMicArray_OutputConverter, &out,
                                         &bad_keepdimarg)) {
             Py_XDECREF(otype);
             return NULL;
@@ -3084,6 +3306,17 @@ PyMUFunc_GenericReduction(PyUFuncObject *ufunc, PyObject *args,
         otype = PyArray_DescrFromType(typenum);
     }
 
+    /* Stream transfers may still be using the operands */
+    PyMicStream_Fence((PyObject *)mp, 0);
+    if (out != NULL) {
+        PyMicStream_Fence((PyObject *)out, 1);
+        if (mpy_lazy_written((PyObject *)out) < 0) {
+            Py_XDECREF(indices);
+            Py_DECREF(otype);
+            Py_DECREF(mp);
+            return NULL;
+        }
+    }
 
     switch(operation) {
     case UFUNC_REDUCE:
@@ -3316,8 +3549,138 @@ handle_out:
     return;
 }
 
+/*
+ * Fast path of binary calls on a device array and a Python or numpy
+ * scalar, like arr * 2.0.  The scalar stays on the host: it takes part
+ * in type resolution as a host 0-d array and is then passed by value
+ * to the trivial loop, so no device array is allocated or filled for
+ * it.  Returns Py_NotImplemented for calls the fast path doesn't
+ * handle.
+ */
 static PyObject *
-mufunc_generic_call(PyUFuncObject *ufunc, PyObject *args, PyObject *kwds)
+scalar_operand_call(PyUFuncObject *ufunc, PyObject *args, PyObject *kwds)
+{
+    int i, k, retcode, needs_api = 0, buffersize = 0, errormask = 0;
+    PyObject *obj[2];
+    PyMicArrayObject *arr, *out = NULL;
+    PyArrayObject *scal = NULL, *conv = NULL;
+    PyArrayObject *op[3] = {NULL, NULL, NULL};
+    PyArray_Descr *dtypes[3] = {NULL, NULL, NULL};
+    PyUFuncGenericFunction innerloop = NULL;
+    void *innerloopdata = NULL;
+    npy_longlong value[MPY_SCALAR_BUFSIZE];
+    const char *ufunc_name = _get_ufunc_name(ufunc);
+    int type_num;
+
+    if (ufunc->nin != 2 || ufunc->nout != 1 || ufunc->core_enabled ||
+            PyTuple_GET_SIZE(args) != 2 ||
+            (kwds != NULL && PyDict_Size(kwds) != 0)) {
+        Py_RETURN_NOTIMPLEMENTED;
+    }
+
+    /* One exact device array with dimensions, one scalar */
+    obj[0] = PyTuple_GET_ITEM(args, 0);
+    obj[1] = PyTuple_GET_ITEM(args, 1);
+    k = PyMicArray_CheckExact(obj[0]) ? 0 : 1;
+    if (!PyMicArray_CheckExact(obj[k]) ||
+            PyMicArray_NDIM((PyMicArrayObject *)obj[k]) == 0 ||
+            !(PyFloat_Check(obj[1 - k]) || PyLong_Check(obj[1 - k]) ||
+              PyInt_Check(obj[1 - k]) || PyComplex_Check(obj[1 - k]) ||
+              PyArray_IsScalar(obj[1 - k], Number) ||
+              PyArray_IsScalar(obj[1 - k], Bool))) {
+        Py_RETURN_NOTIMPLEMENTED;
+    }
+    arr = (PyMicArrayObject *)obj[k];
+
+    scal = (PyArrayObject *)PyArray_FromAny(obj[1 - k], NULL, 0, 0, 0, NULL);
+    if (scal == NULL) {
+        return NULL;
+    }
+    type_num = PyArray_TYPE(scal);
+    if (PyTypeNum_ISFLEXIBLE(type_num) || PyTypeNum_ISOBJECT(type_num) ||
+            PyTypeNum_ISUSERDEF(type_num)) {
+        goto not_implemented;
+    }
+
+    /* The resolver only reads the 0-d operand, which is on the host */
+    op[k] = (PyArrayObject *)arr;
+    op[1 - k] = scal;
+    retcode = ufunc->type_resolver(ufunc, NPY_DEFAULT_ASSIGN_CASTING,
+                                   op, NULL, dtypes);
+    if (retcode == -1) {
+        goto fail;
+    }
+    else if (retcode == -2) {
+        goto not_implemented;
+    }
+    if (ufunc->legacy_inner_loop_selector(ufunc, dtypes, &innerloop,
+                                          &innerloopdata, &needs_api) < 0) {
+        goto fail;
+    }
+    if (needs_api || _does_loop_use_arrays(innerloopdata) ||
+            dtypes[1 - k]->elsize > (int)sizeof(value) ||
+            !PyArray_EquivTypes(PyMicArray_DESCR(arr), dtypes[k]) ||
+            !PyMicArray_ISALIGNED(arr) ||
+            !PyMicArray_TRIVIALLY_ITERABLE(arr)) {
+        goto not_implemented;
+    }
+
+    /* The scalar in the loop dtype */
+    Py_INCREF(dtypes[1 - k]);
+    conv = (PyArrayObject *)PyArray_CastToType(scal, dtypes[1 - k], 0);
+    if (conv == NULL) {
+        goto fail;
+    }
+    memcpy(value, PyArray_DATA(conv), dtypes[1 - k]->elsize);
+
+    Py_INCREF(dtypes[2]);
+    out = (PyMicArrayObject *)PyMicArray_NewFromDescr(
+                                PyMicArray_DEVICE(arr), &PyMicArray_Type,
+                                dtypes[2],
+                                PyMicArray_NDIM(arr), PyMicArray_DIMS(arr),
+                                NULL, NULL,
+                                PyMicArray_ISFORTRAN(arr) ?
+                                            NPY_ARRAY_F_CONTIGUOUS : 0,
+                                NULL);
+    if (out == NULL) {
+        goto fail;
+    }
+
+    if (_get_bufsize_errmask(NULL, ufunc_name, &buffersize, &errormask) < 0) {
+        goto fail;
+    }
+    PyUFunc_clearfperr();
+    trivial_scalar_loop(arr, 1 - k, value, out, innerloop, innerloopdata);
+    if (_check_ufunc_fperr(errormask, NULL, ufunc_name) < 0) {
+        goto fail;
+    }
+
+    Py_DECREF(scal);
+    Py_DECREF(conv);
+    for (i = 0; i < 3; ++i) {
+        Py_DECREF(dtypes[i]);
+    }
+    return PyMicArray_Return(out);
+
+not_implemented:
+    Py_DECREF(scal);
+    for (i = 0; i < 3; ++i) {
+        Py_XDECREF(dtypes[i]);
+    }
+    Py_RETURN_NOTIMPLEMENTED;
+
+fail:
+    Py_XDECREF(scal);
+    Py_XDECREF(conv);
+    Py_XDECREF(out);
+    for (i = 0; i < 3; ++i) {
+        Py_XDECREF(dtypes[i]);
+    }
+    return NULL;
+}
+
+static PyObject *
+mufunc_generic_call_int(PyUFuncObject *ufunc, PyObject *args, PyObject *kwds)
 {
     int i;
     PyTupleObject *ret;
@@ -3336,6 +3699,13 @@ mufunc_generic_call(PyUFuncObject *ufunc, PyObject *args, PyObject *kwds)
         mps[i] = NULL;
     }
 
+    /* Array-scalar operations don't need to stage the scalar */
+    res = scalar_operand_call(ufunc, args, kwds);
+    if (res != Py_NotImplemented) {
+        return res;
+    }
+    Py_DECREF(res);
+
     errval = PyMUFunc_GenericFunction(ufunc, args, kwds, mps);
     if (errval < 0) {
         for (i = 0; i < ufunc->nargs; i++) {
@@ -3434,6 +3804,25 @@ fail:
     return NULL;
 }
 
+static PyObject *
+mufunc_generic_call(PyUFuncObject *ufunc, PyObject *args, PyObject *kwds)
+{
+    PyObject *res, *eager_args;
+
+    /* In lazy mode the call may only be recorded, see lazy.c */
+    if (!mpy_lazy_intercepts(args)) {
+        return mufunc_generic_call_int(ufunc, args, kwds);
+    }
+
+    res = mpy_lazy_call_hook(ufunc, args, kwds, &eager_args);
+    if (eager_args == NULL) {
+        return res;
+    }
+    res = mufunc_generic_call_int(ufunc, eager_args, kwds);
+    Py_DECREF(eager_args);
+    return res;
+}
+
 NPY_NO_EXPORT PyObject *
 ufunc_geterr(PyObject *NPY_UNUSED(dummy), PyObject *args)
 {
@@ -3646,6 +4035,7 @@ _loop1d_list_free(void *ptr)
 static void
 mufunc_dealloc(PyUFuncObject *ufunc)
 {
+    mpy_typecache_invalidate(ufunc);
     PyArray_free(ufunc->core_num_dims);
     PyArray_free(ufunc->core_dim_ixs);
     PyArray_free(ufunc->core_offsets);
@@ -3669,23 +4059,163 @@ mufunc_repr(PyUFuncObject *ufunc)
  *****************************************************************************/
 
 
+/* Converts an argument of outer to a device array on 'device' */
+static PyMicArrayObject *
+outer_operand(PyObject *obj, int device)
+{
+    if (PyMicArray_Check(obj)) {
+        Py_INCREF(obj);
+        return (PyMicArrayObject *)obj;
+    }
+    else if (PyArray_Check(obj)) {
+        return (PyMicArrayObject *)PyMicArray_FromArray(
+                            (PyArrayObject *)obj, NULL, device, 0);
+    }
+    return (PyMicArrayObject *)PyMicArray_FromAny(device, obj,
+                                    NULL, 0, 0, 0, NULL);
+}
+
+/* Returns 'ap' as a C contiguous array of 'dtype', a new reference */
+static PyMicArrayObject *
+outer_contiguous(PyMicArrayObject *ap, PyArray_Descr *dtype)
+{
+    PyMicArrayObject *ret;
+
+    if (PyMicArray_IS_C_CONTIGUOUS(ap) &&
+            PyArray_EquivTypes(PyMicArray_DESCR(ap), dtype)) {
+        Py_INCREF(ap);
+        return ap;
+    }
+    Py_INCREF(dtype);
+    ret = (PyMicArrayObject *)PyMicArray_NewFromDescr(PyMicArray_DEVICE(ap),
+                                &PyMicArray_Type, dtype,
+                                PyMicArray_NDIM(ap), PyMicArray_DIMS(ap),
+                                NULL, NULL, 0, NULL);
+    if (ret != NULL && PyMicArray_CopyInto(ret, ap) < 0) {
+        Py_DECREF(ret);
+        return NULL;
+    }
+    return ret;
+}
+
+/*
+ * Computes op.outer(ap1, ap2) with the cache blocked kernel of outer.c.
+ * Returns Py_NotImplemented when the loop can't run on the device, so
+ * the caller falls back to the broadcasting ufunc call.
+ */
+static PyObject *
+outer_tiled(PyUFuncObject *ufunc, PyMicArrayObject *ap1,
+            PyMicArrayObject *ap2)
+{
+    int i, retcode, needs_api = 0, nd1, nd2, device;
+    PyMicArrayObject *op[3] = {ap1, ap2, NULL};
+    PyMicArrayObject *in1 = NULL, *in2 = NULL, *ret = NULL;
+    PyArray_Descr *dtypes[3] = {NULL, NULL, NULL};
+    PyUFuncGenericFunction innerloop = NULL;
+    void *innerloopdata = NULL;
+    npy_intp shape[NPY_MAXDIMS], n, m;
+    void *ptrs[3];
+    npy_longlong buf[3*4];
+
+    NPY_BEGIN_THREADS_DEF;
+
+    nd1 = PyMicArray_NDIM(ap1);
+    nd2 = PyMicArray_NDIM(ap2);
+    device = PyMicArray_DEVICE(ap1);
+    if (nd1 + nd2 > NPY_MAXDIMS) {
+        PyErr_Format(PyExc_ValueError,
+                "outer result would have %d dimensions, the maximum is %d",
+                nd1 + nd2, NPY_MAXDIMS);
+        return NULL;
+    }
+
+    ufunc_pre_typeresolver(ufunc, op, ptrs, buf, 4);
+    retcode = ufunc->type_resolver(ufunc, NPY_DEFAULT_ASSIGN_CASTING,
+                                   (PyArrayObject **)op, NULL, dtypes);
+    ufunc_post_typeresolver(ufunc, op, ptrs);
+    if (retcode < 0) {
+        /* The resolver may have filled some dtypes before failing */
+        for (i = 0; i < 3; ++i) {
+            Py_XDECREF(dtypes[i]);
+        }
+        if (retcode == -2) {
+            Py_RETURN_NOTIMPLEMENTED;
+        }
+        return NULL;
+    }
+
+    if (ufunc->legacy_inner_loop_selector(ufunc, dtypes, &innerloop,
+                                          &innerloopdata, &needs_api) < 0) {
+        goto fail;
+    }
+    if (needs_api) {
+        for (i = 0; i < 3; ++i) {
+            Py_DECREF(dtypes[i]);
+        }
+        Py_RETURN_NOTIMPLEMENTED;
+    }
+
+    in1 = outer_contiguous(ap1, dtypes[0]);
+    in2 = outer_contiguous(ap2, dtypes[1]);
+    if (in1 == NULL || in2 == NULL) {
+        goto fail;
+    }
+
+    memcpy(shape, PyMicArray_DIMS(ap1), nd1 * sizeof(npy_intp));
+    memcpy(shape + nd1, PyMicArray_DIMS(ap2), nd2 * sizeof(npy_intp));
+    Py_INCREF(dtypes[2]);
+    ret = (PyMicArrayObject *)PyMicArray_NewFromDescr(device,
+                                &PyMicArray_Type, dtypes[2],
+                                nd1 + nd2, shape, NULL, NULL, 0, NULL);
+    if (ret == NULL) {
+        goto fail;
+    }
+
+    n = PyMicArray_SIZE(in1);
+    m = PyMicArray_SIZE(in2);
+    if (n * m > 0) {
+        NPY_BEGIN_THREADS_THRESHOLDED(n * m);
+        mpy_outer_tiled(innerloop, innerloopdata, device,
+                        PyMicArray_DATA(in1), n, dtypes[0]->elsize,
+                        PyMicArray_DATA(in2), m, dtypes[1]->elsize,
+                        PyMicArray_DATA(ret), dtypes[2]->elsize);
+        NPY_END_THREADS;
+    }
+
+    Py_DECREF(in1);
+    Py_DECREF(in2);
+    for (i = 0; i < 3; ++i) {
+        Py_DECREF(dtypes[i]);
+    }
+    return PyMicArray_Return(ret);
+
+fail:
+    Py_XDECREF(in1);
+    Py_XDECREF(in2);
+    for (i = 0; i < 3; ++i) {
+        Py_DECREF(dtypes[i]);
+    }
+    return NULL;
+}
+
 /*
  * op.outer(a,b) is equivalent to op(a[:,NewAxis,NewAxis,etc.],b)
  * where a has b.ndim NewAxis terms appended.
  *
  * The result has dimensions a.ndim + b.ndim
+ *
+ * Plain calls with both operands on one device use a cache blocked
+ * kernel, anything else goes through the broadcasting ufunc call.
  */
 static PyObject *
 mufunc_outer(PyUFuncObject *ufunc, PyObject *args, PyObject *kwds)
 {
-    //TODO
-    int i;
-    int errval;
-    PyObject *override = NULL;
+    int i, device;
     PyObject *ret;
-    PyArrayObject *ap1 = NULL, *ap2 = NULL, *ap_new = NULL;
-    PyObject *new_args, *tmp;
-    PyObject *shape1, *shape2, *newshape;
+    PyObject *tmp, *new_args;
+    PyMicArrayObject *ap1 = NULL, *ap2 = NULL, *ap_new = NULL;
+    npy_intp newdims[NPY_MAXDIMS];
+    PyArray_Dims newshape;
 
     if (ufunc->core_enabled) {
         PyErr_Format(PyExc_TypeError,
@@ -3706,51 +4236,52 @@ mufunc_outer(PyUFuncObject *ufunc, PyObject *args, PyObject *kwds)
         return NULL;
     }
 
-
-    tmp = PySequence_GetItem(args, 0);
-    if (tmp == NULL) {
-        return NULL;
+    /* Place the operands as the ufunc call would */
+    device = PyMicArray_GetCurrentDevice();
+    for (i = 0; i < 2; ++i) {
+        tmp = PyTuple_GET_ITEM(args, i);
+        if (PyMicArray_Check(tmp)) {
+            device = PyMicArray_DEVICE((PyMicArrayObject *)tmp);
+            break;
+        }
     }
-    ap1 = (PyArrayObject *) PyArray_FromObject(tmp, NPY_NOTYPE, 0, 0);
-    Py_DECREF(tmp);
+    ap1 = outer_operand(PyTuple_GET_ITEM(args, 0), device);
     if (ap1 == NULL) {
         return NULL;
     }
-    tmp = PySequence_GetItem(args, 1);
-    if (tmp == NULL) {
-        return NULL;
-    }
-    ap2 = (PyArrayObject *)PyArray_FromObject(tmp, NPY_NOTYPE, 0, 0);
-    Py_DECREF(tmp);
+    ap2 = outer_operand(PyTuple_GET_ITEM(args, 1), device);
     if (ap2 == NULL) {
-        Py_DECREF(ap1);
-        return NULL;
-    }
-    /* Construct new shape tuple */
-    shape1 = PyTuple_New(PyArray_NDIM(ap1));
-    if (shape1 == NULL) {
         goto fail;
     }
-    for (i = 0; i < PyArray_NDIM(ap1); i++) {
-        PyTuple_SET_ITEM(shape1, i,
-                PyLong_FromLongLong((npy_longlong)PyArray_DIMS(ap1)[i]));
-    }
-    shape2 = PyTuple_New(PyArray_NDIM(ap2));
-    for (i = 0; i < PyArray_NDIM(ap2); i++) {
-        PyTuple_SET_ITEM(shape2, i, PyInt_FromLong((long) 1));
+
+    if (ufunc->nout == 1 && (kwds == NULL || PyDict_Size(kwds) == 0) &&
+            PyMicArray_DEVICE(ap1) == PyMicArray_DEVICE(ap2)) {
+        ret = outer_tiled(ufunc, ap1, ap2);
+        if (ret != Py_NotImplemented) {
+            Py_DECREF(ap1);
+            Py_DECREF(ap2);
+            return ret;
+        }
+        Py_DECREF(ret);
     }
-    if (shape2 == NULL) {
-        Py_DECREF(shape1);
+
+    /* Construct new shape */
+    if (PyMicArray_NDIM(ap1) + PyMicArray_NDIM(ap2) > NPY_MAXDIMS) {
+        PyErr_Format(PyExc_ValueError,
+                "outer result would have %d dimensions, the maximum is %d",
+                PyMicArray_NDIM(ap1) + PyMicArray_NDIM(ap2), NPY_MAXDIMS);
         goto fail;
     }
-    newshape = PyNumber_Add(shape1, shape2);
-    Py_DECREF(shape1);
-    Py_DECREF(shape2);
-    if (newshape == NULL) {
-        goto fail;
+    for (i = 0; i < PyMicArray_NDIM(ap1); i++) {
+        newdims[i] = PyMicArray_DIM(ap1, i);
+    }
+    for (i = 0; i < PyMicArray_NDIM(ap2); i++) {
+        newdims[PyMicArray_NDIM(ap1) + i] = 1;
     }
-    ap_new = (PyArrayObject *)PyArray_Reshape(ap1, newshape);
-    Py_DECREF(newshape);
+    newshape.ptr = newdims;
+    newshape.len = PyMicArray_NDIM(ap1) + PyMicArray_NDIM(ap2);
+    ap_new = (PyMicArrayObject *)PyMicArray_Newshape(ap1, &newshape,
+                                                     NPY_CORDER);
     if (ap_new == NULL) {
         goto fail;
     }
@@ -3758,6 +4289,9 @@ mufunc_outer(PyUFuncObject *ufunc, PyObject *args, PyObject *kwds)
     Py_DECREF(ap1);
     Py_DECREF(ap2);
     Py_DECREF(ap_new);
+    if (new_args == NULL) {
+        return NULL;
+    }
     ret = mufunc_generic_call(ufunc, new_args, kwds);
     Py_DECREF(new_args);
     return ret;
@@ -3823,8 +4357,42 @@ new_array_op(PyMicArrayObject *op_array, char *data)
 static PyObject *
 mufunc_at(PyUFuncObject *ufunc, PyObject *args)
 {
-    //TODO
-    return NULL;
+    PyObject *op1 = NULL, *idx = NULL, *op2 = NULL;
+
+    if (ufunc->nin > 2) {
+        PyErr_SetString(PyExc_ValueError,
+            "Only unary and binary ufuncs supported at this time");
+        return NULL;
+    }
+    if (ufunc->nout != 1) {
+        PyErr_SetString(PyExc_ValueError,
+            "Only single output ufuncs supported at this time");
+        return NULL;
+    }
+    if (!PyArg_ParseTuple(args, "OO|O:at", &op1, &idx, &op2)) {
+        return NULL;
+    }
+    if (ufunc->nin == 2 && op2 == NULL) {
+        PyErr_SetString(PyExc_ValueError,
+                        "second operand needed for ufunc");
+        return NULL;
+    }
+    else if (ufunc->nin == 1 && op2 != NULL) {
+        PyErr_SetString(PyExc_ValueError,
+                        "second operand provided when ufunc is unary");
+        return NULL;
+    }
+    if (!PyMicArray_Check(op1)) {
+        PyErr_SetString(PyExc_TypeError,
+                        "first operand must be a device array");
+        return NULL;
+    }
+
+    if (mpy_lazy_written(op1) < 0 ||
+            mpy_scatter_at(ufunc, (PyMicArrayObject *)op1, idx, op2) < 0) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
 }
 
 
@@ -3833,7 +4401,7 @@ NPY_NO_EXPORT struct PyMethodDef mufunc_methods[] = {
     {"reduce",
         (PyCFunction)mufunc_reduce,
         METH_VARARGS | METH_KEYWORDS, NULL },
-    /*{"accumulate",
+    {"accumulate",
         (PyCFunction)mufunc_accumulate,
         METH_VARARGS | METH_KEYWORDS, NULL },
     {"reduceat",
@@ -3844,7 +4412,7 @@ NPY_NO_EXPORT struct PyMethodDef mufunc_methods[] = {
         METH_VARARGS | METH_KEYWORDS, NULL},
     {"at",
         (PyCFunction)mufunc_at,
-        METH_VARARGS, NULL},*/
+        METH_VARARGS, NULL},
     {NULL, NULL, 0, NULL}           /* sentinel */
 };
 
@@ -0,0 +1,156 @@
+/*
+ * Cache blocked kernel for ufunc.outer.
+ *
+ * The (n, m) result is cut into tiles of MPY_OUTER_TI rows by
+ * MPY_OUTER_TJ columns.  A row of a tile is a single call of the
+ * ufunc's inner loop with the item of 'a' as a stride 0 operand, so
+ * the contiguous scalar-operand loops are used.  Tiles are handed out
+ * column band by column band, so a thread keeps reusing the same
+ * MPY_OUTER_TJ items of 'b' from its cache while 'a' is streamed.
+ *
+ * Outputs too big for the caches are first computed into a per-thread
+ * tile buffer and then written with streaming stores, so that they
+ * neither evict the operand tiles nor cost a read for ownership.
+ *
+ * When 'b' is too short to fill a useful row, the roles are swapped:
+ * every call walks a strided column of the output over a band of 'a'.
+ */
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#define NPY_NO_DEPRECATED_API NPY_API_VERSION
+#define PY_ARRAY_UNIQUE_SYMBOL _mpy_umathmodule_ARRAY_API
+#define NO_IMPORT_ARRAY
+#define PY_UFUNC_UNIQUE_SYMBOL _mpy_umathmodule_UFUNC_API
+#define NO_IMPORT_UFUNC
+#include <numpy/npy_common.h>
+#include <numpy/arrayobject.h>
+#include <numpy/ufuncobject.h>
+#include <numpy/npy_3kcompat.h>
+
+#define PyMicArray_API_UNIQUE_NAME _mpy_umathmodule_MICARRAY_API
+#define PyMicArray_NO_IMPORT
+#include <multiarray/arrayobject.h>
+#include <multiarray/multiarray_api.h>
+#include <multiarray/mpy_common.h>
+#include <multiarray/common.h>
+
+#define _MICARRAY_UMATHMODULE
+#include "mufunc_object.h"
+#include "outer.h"
+
+/* Tile shape, a tile of doubles is 32KiB */
+#define MPY_OUTER_TI 8
+#define MPY_OUTER_TJ 512
+/* Outputs from this size on are written with streaming stores */
+#define MPY_OUTER_STREAM_BYTES (16 * 1024 * 1024)
+
+/* memcpy with non-temporal stores where the compiler supports them */
+static MPY_TARGET_MIC void
+stream_copy(char *dst, const char *src, npy_intp nbytes)
+{
+    npy_uint64 *d = (npy_uint64 *)dst;
+    const npy_uint64 *s = (const npy_uint64 *)src;
+    npy_intp i, n = nbytes / 8;
+
+    if ((((npy_uintp)dst) | ((npy_uintp)src) | (npy_uintp)nbytes) & 7) {
+        memcpy(dst, src, nbytes);
+        return;
+    }
+#ifdef __INTEL_COMPILER
+#pragma vector nontemporal
+#endif
+    for (i = 0; i < n; ++i) {
+        d[i] = s[i];
+    }
+}
+
+NPY_NO_EXPORT void
+mpy_outer_tiled(PyUFuncGenericFunction innerloop, void *innerloopdata,
+                int device,
+                char *a, npy_intp n, npy_intp asize,
+                char *b, npy_intp m, npy_intp bsize,
+                char *out, npy_intp osize)
+{
+    MPY_TARGET_MIC PyUFuncGenericFunction loop = innerloop;
+    MPY_TARGET_MIC void *loopdata = innerloopdata;
+    int stream = (n * m * osize >= MPY_OUTER_STREAM_BYTES);
+    int columns = (m < MPY_OUTER_TI && n > m);
+
+#pragma omp target device(device) map(to: loop, loopdata, a, n, asize, \
+                                          b, m, bsize, out, osize, \
+                                          stream, columns)
+    {
+        if (columns) {
+            /* Few columns: one call per column of a band of rows */
+            npy_intp nbands = (n + MPY_OUTER_TJ - 1) / MPY_OUTER_TJ;
+            npy_intp band;
+
+            #pragma omp parallel for schedule(static)
+            for (band = 0; band < nbands; ++band) {
+                npy_intp i0 = band * MPY_OUTER_TJ, ni = n - i0, j;
+                char *args[3];
+                npy_intp steps[3];
+
+                if (ni > MPY_OUTER_TJ) {
+                    ni = MPY_OUTER_TJ;
+                }
+                args[0] = a + i0 * asize;
+                steps[0] = asize;
+                steps[1] = 0;
+                steps[2] = m * osize;
+                for (j = 0; j < m; ++j) {
+                    args[1] = b + j * bsize;
+                    args[2] = out + (i0 * m + j) * osize;
+                    loop(args, &ni, steps, loopdata);
+                }
+            }
+        }
+        else {
+            npy_intp nti = (n + MPY_OUTER_TI - 1) / MPY_OUTER_TI;
+            npy_intp ntj = (m + MPY_OUTER_TJ - 1) / MPY_OUTER_TJ;
+
+            #pragma omp parallel
+            {
+                char *tile = stream ?
+                        malloc(MPY_OUTER_TI * MPY_OUTER_TJ * osize) : NULL;
+                npy_intp task;
+
+                /* Consecutive tasks share their tile of b */
+                #pragma omp for schedule(static)
+                for (task = 0; task < nti * ntj; ++task) {
+                    npy_intp i0 = (task % nti) * MPY_OUTER_TI;
+                    npy_intp j0 = (task / nti) * MPY_OUTER_TJ;
+                    npy_intp ni = n - i0, nj = m - j0, i;
+                    char *args[3];
+                    npy_intp steps[3];
+
+                    if (ni > MPY_OUTER_TI) {
+                        ni = MPY_OUTER_TI;
+                    }
+                    if (nj > MPY_OUTER_TJ) {
+                        nj = MPY_OUTER_TJ;
+                    }
+                    args[1] = b + j0 * bsize;
+                    steps[0] = 0;
+                    steps[1] = bsize;
+                    steps[2] = osize;
+                    for (i = 0; i < ni; ++i) {
+                        args[0] = a + (i0 + i) * asize;
+                        args[2] = tile ? tile + i * nj * osize :
+                                         out + ((i0 + i) * m + j0) * osize;
+                        loop(args, &nj, steps, loopdata);
+                    }
+                    if (tile) {
+                        for (i = 0; i < ni; ++i) {
+                            stream_copy(out + ((i0 + i) * m + j0) * osize,
+                                        tile + i * nj * osize, nj * osize);
+                        }
+                    }
+                }
+
+                free(tile);
+            }
+        }
+    }
+}
@@ -0,0 +1,16 @@
+#ifndef _MPY_MUFUNC_OUTER_H
+#define _MPY_MUFUNC_OUTER_H
+
+/*
+ * out[i, j] = a[i] op b[j] for contiguous device buffers 'a' (n items),
+ * 'b' (m items) and 'out' (n*m items), using the binary inner loop
+ * 'innerloop'.  Must be called without the GIL.
+ */
+NPY_NO_EXPORT void
+mpy_outer_tiled(PyUFuncGenericFunction innerloop, void *innerloopdata,
+                int device,
+                char *a, npy_intp n, npy_intp asize,
+                char *b, npy_intp m, npy_intp bsize,
+                char *out, npy_intp osize);
+
+#endif
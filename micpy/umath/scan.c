@@ -0,0 +1,364 @@
+/*
+ * Parallel prefix scan for ufunc.accumulate (and cumsum/cumprod).
+ *
+ * The result is computed in a C contiguous buffer viewed as
+ * (outer, n, inner), where n is the length of the accumulation axis.
+ * Every run of 'inner' items at a fixed position along the axis is
+ * contiguous, so a step of the scan is one call of the ordinary inner
+ * loop of the ufunc over a whole row of lanes:
+ *
+ *      dst[i] = dst[i - 1] op src[i]
+ *
+ * The lanes are split in blocks of MPY_SCAN_LANES items.  When there
+ * are enough (outer, block) tasks to occupy all device threads, every
+ * thread scans whole tasks serially.  Otherwise each task is scanned
+ * with the blocked three phase algorithm, which needs an associative
+ * operation:
+ *
+ *   1. every thread scans its own contiguous range of the axis,
+ *   2. one thread carries the last row of each range into the last
+ *      row of the next one, which makes those rows final,
+ *   3. every thread combines the last row of the preceding range into
+ *      the remaining rows of its own range.
+ *
+ * Everything runs inside a single target region.
+ */
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#define NPY_NO_DEPRECATED_API NPY_API_VERSION
+#define PY_ARRAY_UNIQUE_SYMBOL _mpy_umathmodule_ARRAY_API
+#define NO_IMPORT_ARRAY
+#define PY_UFUNC_UNIQUE_SYMBOL _mpy_umathmodule_UFUNC_API
+#define NO_IMPORT_UFUNC
+#include <numpy/npy_common.h>
+#include <numpy/arrayobject.h>
+#include <numpy/ufuncobject.h>
+#include <numpy/npy_3kcompat.h>
+
+#define PyMicArray_API_UNIQUE_NAME _mpy_umathmodule_MICARRAY_API
+#define PyMicArray_NO_IMPORT
+#include <multiarray/arrayobject.h>
+#include <multiarray/multiarray_api.h>
+#include <multiarray/mpy_common.h>
+#include <multiarray/common.h>
+#include <multiarray/mpymem_overlap.h>
+
+#define _MICARRAY_UMATHMODULE
+#include "mufunc_object.h"
+#include "scan.h"
+
+/* Lanes handled by one task of the scan */
+#define MPY_SCAN_LANES 1024
+/* Shortest range of the axis worth a thread of its own */
+#define MPY_SCAN_MINROWS 4096
+
+/*
+ * Ufuncs whose operation is associative, so that a scan may be split
+ * into independent ranges.  Floating point add and multiply are only
+ * associative up to rounding, like the pairwise sum used by reduce.
+ */
+static const char *associative_ufuncs[] = {
+    "add", "multiply", "maximum", "minimum", "fmax", "fmin",
+    "logical_and", "logical_or", "bitwise_and", "bitwise_or",
+    "bitwise_xor", NULL
+};
+
+static int
+is_associative(PyUFuncObject *ufunc)
+{
+    const char **name;
+
+    if (ufunc->name == NULL) {
+        return 0;
+    }
+    for (name = associative_ufuncs; *name != NULL; ++name) {
+        if (strcmp(ufunc->name, *name) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Scans rows [start, end) of a task: dst[start] = src[start] and
+ * dst[i] = dst[i - 1] op src[i] after it.  Rows are 'width' items of
+ * 'itemsize' bytes, 'rowstride' bytes apart.
+ */
+static MPY_TARGET_MIC void
+scan_rows(PyUFuncGenericFunction innerloop, void *innerloopdata,
+          char *src, char *dst, npy_intp start, npy_intp end,
+          npy_intp rowstride, npy_intp width, npy_intp itemsize)
+{
+    char *args[3];
+    npy_intp steps[3], count, i;
+
+    if (start >= end) {
+        return;
+    }
+    if (src != dst) {
+        memmove(dst + start*rowstride, src + start*rowstride,
+                width*itemsize);
+    }
+
+    if (width == 1) {
+        /* The whole range in one call, as the serial accumulate does */
+        args[0] = dst + start*rowstride;
+        args[1] = src + (start + 1)*rowstride;
+        args[2] = dst + (start + 1)*rowstride;
+        steps[0] = steps[1] = steps[2] = rowstride;
+        count = end - start - 1;
+        if (count > 0) {
+            innerloop(args, &count, steps, innerloopdata);
+        }
+        return;
+    }
+
+    steps[0] = steps[1] = steps[2] = itemsize;
+    count = width;
+    for (i = start + 1; i < end; ++i) {
+        args[0] = dst + (i - 1)*rowstride;
+        args[1] = src + i*rowstride;
+        args[2] = dst + i*rowstride;
+        innerloop(args, &count, steps, innerloopdata);
+    }
+}
+
+/* dst[i] = dst[prev] op dst[i] for rows [start, end) of a task */
+static MPY_TARGET_MIC void
+fixup_rows(PyUFuncGenericFunction innerloop, void *innerloopdata,
+           char *dst, npy_intp prev, npy_intp start, npy_intp end,
+           npy_intp rowstride, npy_intp width, npy_intp itemsize)
+{
+    char *args[3];
+    npy_intp steps[3], count, i;
+
+    if (start >= end) {
+        return;
+    }
+
+    if (width == 1) {
+        args[0] = dst + prev*rowstride;
+        args[1] = args[2] = dst + start*rowstride;
+        steps[0] = 0;
+        steps[1] = steps[2] = rowstride;
+        count = end - start;
+        innerloop(args, &count, steps, innerloopdata);
+        return;
+    }
+
+    steps[0] = steps[1] = steps[2] = itemsize;
+    count = width;
+    args[0] = dst + prev*rowstride;
+    for (i = start; i < end; ++i) {
+        args[1] = args[2] = dst + i*rowstride;
+        innerloop(args, &count, steps, innerloopdata);
+    }
+}
+
+/* Runs the scan of one task with all threads of the device */
+static MPY_TARGET_MIC void
+scan_task_blocked(PyUFuncGenericFunction innerloop, void *innerloopdata,
+                  char *src, char *dst, npy_intp n,
+                  npy_intp rowstride, npy_intp width, npy_intp itemsize)
+{
+    #pragma omp parallel
+    {
+        npy_intp nthreads = omp_get_num_threads();
+        npy_intp t = omp_get_thread_num();
+        npy_intp chunk = (n + nthreads - 1) / nthreads;
+        npy_intp start = t * chunk, end = start + chunk, u;
+
+        if (end > n) {
+            end = n;
+        }
+
+        /* 1. Local scans */
+        scan_rows(innerloop, innerloopdata, src, dst, start, end,
+                  rowstride, width, itemsize);
+        #pragma omp barrier
+
+        /* 2. Make the last row of every range final */
+        #pragma omp single
+        for (u = 1; u * chunk < n; ++u) {
+            npy_intp last = (u + 1) * chunk - 1;
+            if (last >= n) {
+                last = n - 1;
+            }
+            fixup_rows(innerloop, innerloopdata, dst, u * chunk - 1,
+                       last, last + 1, rowstride, width, itemsize);
+        }
+
+        /* 3. Carry the preceding range into the others */
+        if (t > 0) {
+            fixup_rows(innerloop, innerloopdata, dst, start - 1,
+                       start, end - 1, rowstride, width, itemsize);
+        }
+    }
+}
+
+/*
+ * Scans 'src' into 'dst' (which may be the same buffer), both C
+ * contiguous with shape (outer, n, inner) and items of 'itemsize'.
+ */
+static void
+run_scan(PyUFuncGenericFunction innerloop, void *innerloopdata,
+         int device, int blocked_ok, char *src, char *dst,
+         npy_intp outer, npy_intp n, npy_intp inner, npy_intp itemsize)
+{
+    MPY_TARGET_MIC PyUFuncGenericFunction loop = innerloop;
+    MPY_TARGET_MIC void *loopdata = innerloopdata;
+
+#pragma omp target device(device) map(to: loop, loopdata, src, dst, \
+                                          outer, n, inner, itemsize, \
+                                          blocked_ok)
+    {
+        npy_intp nblocks = (inner + MPY_SCAN_LANES - 1) / MPY_SCAN_LANES;
+        npy_intp ntasks = outer * nblocks, task;
+        npy_intp rowstride = inner * itemsize;
+
+        if (!blocked_ok || ntasks >= omp_get_max_threads() ||
+                n < 2 * MPY_SCAN_MINROWS) {
+            /* Enough independent tasks, or too short to split */
+            #pragma omp parallel for schedule(dynamic)
+            for (task = 0; task < ntasks; ++task) {
+                npy_intp r = task / nblocks, k = task % nblocks;
+                npy_intp offset = (r * n * inner + k * MPY_SCAN_LANES) *
+                                                                itemsize;
+                npy_intp width = inner - k * MPY_SCAN_LANES;
+
+                if (width > MPY_SCAN_LANES) {
+                    width = MPY_SCAN_LANES;
+                }
+                scan_rows(loop, loopdata, src + offset, dst + offset,
+                          0, n, rowstride, width, itemsize);
+            }
+        }
+        else {
+            for (task = 0; task < ntasks; ++task) {
+                npy_intp r = task / nblocks, k = task % nblocks;
+                npy_intp offset = (r * n * inner + k * MPY_SCAN_LANES) *
+                                                                itemsize;
+                npy_intp width = inner - k * MPY_SCAN_LANES;
+
+                if (width > MPY_SCAN_LANES) {
+                    width = MPY_SCAN_LANES;
+                }
+                scan_task_blocked(loop, loopdata, src + offset,
+                                  dst + offset, n, rowstride, width,
+                                  itemsize);
+            }
+        }
+    }
+}
+
+NPY_NO_EXPORT PyMicArrayObject *
+mpy_scan_accumulate(PyUFuncObject *ufunc, PyMicArrayObject *arr,
+                    PyMicArrayObject *out, int axis, PyArray_Descr *dtype)
+{
+    PyArray_Descr *dtypes[3];
+    PyUFuncGenericFunction innerloop = NULL;
+    void *innerloopdata = NULL;
+    PyMicArrayObject *work;
+    npy_intp outer = 1, inner = 1, n;
+    int i, ndim, device, needs_api = 0;
+    char *src;
+    const char *ufunc_name = ufunc->name ? ufunc->name : "<unnamed ufunc>";
+
+    NPY_BEGIN_THREADS_DEF;
+
+    ndim = PyMicArray_NDIM(arr);
+    device = PyMicArray_DEVICE(arr);
+
+    dtypes[0] = dtypes[1] = dtypes[2] = dtype;
+    if (ufunc->legacy_inner_loop_selector(ufunc, dtypes, &innerloop,
+                                          &innerloopdata, &needs_api) < 0) {
+        return NULL;
+    }
+    if (needs_api) {
+        PyErr_Format(PyExc_TypeError,
+                "%s.accumulate is not supported for dtype %S",
+                ufunc_name, (PyObject *)dtype);
+        return NULL;
+    }
+
+    if (out != NULL) {
+        if (PyMicArray_NDIM(out) != ndim ||
+                !PyArray_CompareLists(PyMicArray_DIMS(out),
+                                      PyMicArray_DIMS(arr), ndim)) {
+            PyErr_Format(PyExc_ValueError,
+                    "output parameter for %s.accumulate must have the "
+                    "shape of the input", ufunc_name);
+            return NULL;
+        }
+        if (PyMicArray_FailUnlessWriteable(out, "output array") < 0) {
+            return NULL;
+        }
+    }
+
+    for (i = 0; i < axis; ++i) {
+        outer *= PyMicArray_DIM(arr, i);
+    }
+    n = PyMicArray_DIM(arr, axis);
+    for (i = axis + 1; i < ndim; ++i) {
+        inner *= PyMicArray_DIM(arr, i);
+    }
+
+    /*
+     * Scan straight into 'out' when it already has the working layout.
+     * 'out' may be 'arr' itself, as every item is read before it is
+     * overwritten.
+     */
+    if (out != NULL && PyMicArray_IS_C_CONTIGUOUS(out) &&
+            PyArray_EquivTypes(PyMicArray_DESCR(out), dtype) &&
+            PyMicArray_DEVICE(out) == device &&
+            (PyMicArray_DATA(out) == PyMicArray_DATA(arr) ?
+                (PyMicArray_IS_C_CONTIGUOUS(arr) &&
+                 PyArray_EquivTypes(PyMicArray_DESCR(arr), dtype)) :
+                solve_may_share_memory(arr, out, 1) == 0)) {
+        Py_INCREF(out);
+        work = out;
+    }
+    else {
+        Py_INCREF(dtype);
+        work = (PyMicArrayObject *)PyMicArray_NewFromDescr(device,
+                                    &PyMicArray_Type, dtype,
+                                    ndim, PyMicArray_DIMS(arr), NULL,
+                                    NULL, 0, NULL);
+        if (work == NULL) {
+            return NULL;
+        }
+    }
+
+    /* Read the input in place if it needs neither a cast nor a copy */
+    if (PyMicArray_IS_C_CONTIGUOUS(arr) &&
+            PyArray_EquivTypes(PyMicArray_DESCR(arr), dtype)) {
+        src = PyMicArray_DATA(arr);
+    }
+    else {
+        if (PyMicArray_CopyInto(work, arr) < 0) {
+            Py_DECREF(work);
+            return NULL;
+        }
+        src = PyMicArray_DATA(work);
+    }
+
+    if (outer * n * inner > 0) {
+        NPY_BEGIN_THREADS_THRESHOLDED(outer * n * inner);
+        run_scan(innerloop, innerloopdata, device, is_associative(ufunc),
+                 src, PyMicArray_DATA(work), outer, n, inner,
+                 dtype->elsize);
+        NPY_END_THREADS;
+    }
+
+    if (out != NULL && work != out) {
+        if (PyMicArray_CopyInto(out, work) < 0) {
+            Py_DECREF(work);
+            return NULL;
+        }
+        Py_DECREF(work);
+        Py_INCREF(out);
+        return out;
+    }
+    return work;
+}
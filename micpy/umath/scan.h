@@ -0,0 +1,12 @@
+#ifndef _MPY_MUFUNC_SCAN_H
+#define _MPY_MUFUNC_SCAN_H
+
+/*
+ * ufunc.accumulate along 'axis' of 'arr', computed in 'dtype' on the
+ * device of 'arr'.  'out' may be NULL.  Returns a new reference.
+ */
+NPY_NO_EXPORT PyMicArrayObject *
+mpy_scan_accumulate(PyUFuncObject *ufunc, PyMicArrayObject *arr,
+                    PyMicArrayObject *out, int axis, PyArray_Descr *dtype);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef _MPY_MUFUNC_SCATTER_H
+#define _MPY_MUFUNC_SCATTER_H
+
+/*
+ * ufunc.at(op1, idx, op2) for a device array 'op1'.  'idx' is an
+ * integer index, an integer array or a tuple of them indexing the
+ * leading axes of 'op1'.  'op2' is NULL for unary ufuncs.
+ * Returns 0 on success, -1 with an exception set on failure.
+ */
+NPY_NO_EXPORT int
+mpy_scatter_at(PyUFuncObject *ufunc, PyMicArrayObject *op1,
+               PyObject *idx, PyObject *op2);
+
+#endif
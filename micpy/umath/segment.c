@@ -0,0 +1,394 @@
+/*
+ * Segmented reduction for ufunc.reduceat.
+ *
+ * As in scan.c, the input is viewed as a C contiguous (outer, n, inner)
+ * block and the result as (outer, m, inner), with n the length of the
+ * axis and m the number of indices.  Segment i covers the rows
+ * [indices[i], indices[i+1]) of the axis, the last one runs to n, and
+ * a segment whose end is not past its start is just row indices[i].
+ *
+ * The segments are cut into pieces on the host.  If the ufunc is
+ * reorderable, segments longer than the piece length are split, so a
+ * few huge segments can't leave most device threads idle.  The first
+ * piece of a segment reduces into the result row, the others into rows
+ * of a scratch buffer which a second pass folds into the result.  Every
+ * piece is reduced by the ufunc's own inner loop, as in reduce, and all
+ * (outer, lane block, piece) tasks are handed out dynamically inside a
+ * single target region.
+ */
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#define NPY_NO_DEPRECATED_API NPY_API_VERSION
+#define PY_ARRAY_UNIQUE_SYMBOL _mpy_umathmodule_ARRAY_API
+#define NO_IMPORT_ARRAY
+#define PY_UFUNC_UNIQUE_SYMBOL _mpy_umathmodule_UFUNC_API
+#define NO_IMPORT_UFUNC
+#include <numpy/npy_common.h>
+#include <numpy/arrayobject.h>
+#include <numpy/ufuncobject.h>
+#include <numpy/npy_3kcompat.h>
+
+#define PyMicArray_API_UNIQUE_NAME _mpy_umathmodule_MICARRAY_API
+#define PyMicArray_NO_IMPORT
+#include <multiarray/arrayobject.h>
+#include <multiarray/multiarray_api.h>
+#include <multiarray/mpy_common.h>
+#include <multiarray/common.h>
+#include <multiarray/mpymem_overlap.h>
+
+#define _MICARRAY_UMATHMODULE
+#include "mufunc_object.h"
+#include "segment.h"
+
+/* Lanes handled by one task */
+#define MPY_SEGMENT_LANES 1024
+/* Pieces are never cut shorter than this many rows */
+#define MPY_SEGMENT_MINROWS 4096
+/* Number of pieces the split aims at, for load balancing */
+#define MPY_SEGMENT_TARGET_PIECES 1024
+
+/* A piece: rows [start, end) of the axis reduced into row 'dst' */
+#define PIECE_DST 0
+#define PIECE_START 1
+#define PIECE_END 2
+#define PIECE_SIZE 3
+
+/*
+ * Reduces rows [start, end) of 'src' into the row 'dst'.  Rows are
+ * 'width' items of 'itemsize' bytes, 'rowstride' bytes apart.
+ */
+static MPY_TARGET_MIC void
+reduce_rows(PyUFuncGenericFunction innerloop, void *innerloopdata,
+            char *src, char *dst, npy_intp start, npy_intp end,
+            npy_intp rowstride, npy_intp width, npy_intp itemsize)
+{
+    char *args[3];
+    npy_intp steps[3], count, i;
+
+    memmove(dst, src + start*rowstride, width*itemsize);
+
+    if (width == 1) {
+        /* A single call in the layout of reduce, for the fast loops */
+        args[0] = args[2] = dst;
+        args[1] = src + (start + 1)*rowstride;
+        steps[0] = steps[2] = 0;
+        steps[1] = rowstride;
+        count = end - start - 1;
+        if (count > 0) {
+            innerloop(args, &count, steps, innerloopdata);
+        }
+        return;
+    }
+
+    args[0] = args[2] = dst;
+    steps[0] = steps[1] = steps[2] = itemsize;
+    count = width;
+    for (i = start + 1; i < end; ++i) {
+        args[1] = src + i*rowstride;
+        innerloop(args, &count, steps, innerloopdata);
+    }
+}
+
+static void
+run_segments(PyUFuncGenericFunction innerloop, void *innerloopdata,
+             int device, char *src, char *dst, char *scratch,
+             npy_intp *pieces, npy_intp npieces,
+             npy_intp *folds, npy_intp nfolds, npy_intp nscratch,
+             npy_intp outer, npy_intp n, npy_intp m, npy_intp inner,
+             npy_intp itemsize)
+{
+    MPY_TARGET_MIC PyUFuncGenericFunction loop = innerloop;
+    MPY_TARGET_MIC void *loopdata = innerloopdata;
+
+#pragma omp target device(device) \
+                   map(to: pieces[0:npieces*PIECE_SIZE], \
+                           folds[0:nfolds*PIECE_SIZE+1], \
+                           loop, loopdata, src, dst, scratch, npieces, \
+                           nfolds, nscratch, outer, n, m, inner, itemsize)
+    {
+        npy_intp nblocks = (inner + MPY_SEGMENT_LANES - 1) /
+                                                    MPY_SEGMENT_LANES;
+        npy_intp rowstride = inner * itemsize;
+        npy_intp task;
+
+        #pragma omp parallel
+        {
+            #pragma omp for schedule(dynamic)
+            for (task = 0; task < outer * nblocks * npieces; ++task) {
+                npy_intp *piece = pieces + (task % npieces) * PIECE_SIZE;
+                npy_intp rest = task / npieces;
+                npy_intp r = rest / nblocks, k = rest % nblocks;
+                npy_intp lane = k * MPY_SEGMENT_LANES;
+                npy_intp width = inner - lane;
+                npy_intp row = piece[PIECE_DST];
+                char *out;
+
+                if (width > MPY_SEGMENT_LANES) {
+                    width = MPY_SEGMENT_LANES;
+                }
+                if (row < m) {
+                    out = dst + ((r * m + row) * inner + lane) * itemsize;
+                }
+                else {
+                    out = scratch + ((r * nscratch + row - m) * inner +
+                                     lane) * itemsize;
+                }
+                reduce_rows(loop, loopdata,
+                            src + (r * n * inner + lane) * itemsize, out,
+                            piece[PIECE_START], piece[PIECE_END],
+                            rowstride, width, itemsize);
+            }
+
+            /* Fold the scratch rows of split segments into the result */
+            #pragma omp for schedule(dynamic)
+            for (task = 0; task < outer * nblocks * nfolds; ++task) {
+                npy_intp *fold = folds + (task % nfolds) * PIECE_SIZE;
+                npy_intp rest = task / nfolds;
+                npy_intp r = rest / nblocks, k = rest % nblocks;
+                npy_intp lane = k * MPY_SEGMENT_LANES;
+                npy_intp width = inner - lane;
+                char *args[3];
+                npy_intp steps[3], i;
+
+                if (width > MPY_SEGMENT_LANES) {
+                    width = MPY_SEGMENT_LANES;
+                }
+                args[0] = args[2] = dst + ((r * m + fold[PIECE_DST]) *
+                                           inner + lane) * itemsize;
+                steps[0] = steps[1] = steps[2] = itemsize;
+                for (i = fold[PIECE_START]; i < fold[PIECE_END]; ++i) {
+                    args[1] = scratch + ((r * nscratch + i) * inner +
+                                         lane) * itemsize;
+                    loop(args, &width, steps, loopdata);
+                }
+            }
+        }
+    }
+}
+
+NPY_NO_EXPORT PyMicArrayObject *
+mpy_segment_reduceat(PyUFuncObject *ufunc, PyMicArrayObject *arr,
+                     PyArrayObject *indices, PyMicArrayObject *out,
+                     int axis, PyArray_Descr *dtype)
+{
+    PyArray_Descr *dtypes[3];
+    PyUFuncGenericFunction innerloop = NULL;
+    void *innerloopdata = NULL;
+    PyMicArrayObject *work = NULL, *input = NULL, *scratch = NULL;
+    npy_intp shape[NPY_MAXDIMS];
+    npy_intp outer = 1, inner = 1, n, m, i, total = 0, piecelen;
+    npy_intp npieces = 0, nfolds = 0, nscratch = 0;
+    npy_intp *ind, *pieces = NULL, *folds = NULL;
+    int ndim, device, needs_api = 0, reorderable;
+    const char *ufunc_name = ufunc->name ? ufunc->name : "<unnamed ufunc>";
+
+    NPY_BEGIN_THREADS_DEF;
+
+    ndim = PyMicArray_NDIM(arr);
+    device = PyMicArray_DEVICE(arr);
+    n = PyMicArray_DIM(arr, axis);
+    m = PyArray_SIZE(indices);
+    ind = (npy_intp *)PyArray_DATA(indices);
+
+    dtypes[0] = dtypes[1] = dtypes[2] = dtype;
+    if (ufunc->legacy_inner_loop_selector(ufunc, dtypes, &innerloop,
+                                          &innerloopdata, &needs_api) < 0) {
+        return NULL;
+    }
+    if (needs_api) {
+        PyErr_Format(PyExc_TypeError,
+                "%s.reduceat is not supported for dtype %S",
+                ufunc_name, (PyObject *)dtype);
+        return NULL;
+    }
+
+    for (i = 0; i < m; ++i) {
+        if (ind[i] < 0 || ind[i] >= n) {
+            PyErr_Format(PyExc_IndexError,
+                    "index %" NPY_INTP_FMT " out-of-bounds in %s.reduceat "
+                    "[0, %" NPY_INTP_FMT ")", ind[i], ufunc_name, n);
+            return NULL;
+        }
+    }
+
+    memcpy(shape, PyMicArray_DIMS(arr), ndim * sizeof(npy_intp));
+    shape[axis] = m;
+    for (i = 0; i < axis; ++i) {
+        outer *= shape[i];
+    }
+    for (i = axis + 1; i < ndim; ++i) {
+        inner *= shape[i];
+    }
+
+    if (out != NULL) {
+        if (PyMicArray_NDIM(out) != ndim ||
+                !PyArray_CompareLists(PyMicArray_DIMS(out), shape, ndim)) {
+            PyErr_Format(PyExc_ValueError,
+                    "output parameter for %s.reduceat has the wrong shape",
+                    ufunc_name);
+            return NULL;
+        }
+        if (PyMicArray_FailUnlessWriteable(out, "output array") < 0) {
+            return NULL;
+        }
+    }
+
+    switch (ufunc->identity) {
+        case PyUFunc_Zero:
+        case PyUFunc_One:
+        case PyUFunc_MinusOne:
+        case PyUFunc_ReorderableNone:
+            reorderable = 1;
+            break;
+        default:
+            reorderable = 0;
+            break;
+    }
+
+    /* Cut the segments into pieces */
+    for (i = 0; i < m; ++i) {
+        npy_intp end = (i + 1 < m) ? ind[i + 1] : n;
+        total += (end > ind[i]) ? end - ind[i] : 1;
+    }
+    piecelen = total / MPY_SEGMENT_TARGET_PIECES;
+    if (piecelen < MPY_SEGMENT_MINROWS) {
+        piecelen = MPY_SEGMENT_MINROWS;
+    }
+    if (!reorderable) {
+        piecelen = NPY_MAX_INTP;
+    }
+    for (i = 0; i < m; ++i) {
+        npy_intp end = (i + 1 < m) ? ind[i + 1] : n;
+        npy_intp len = (end > ind[i]) ? end - ind[i] : 1;
+        /* not len + piecelen - 1, piecelen may be NPY_MAX_INTP */
+        npy_intp count = 1 + (len - 1) / piecelen;
+
+        npieces += count;
+        if (count > 1) {
+            nfolds++;
+            nscratch += count - 1;
+        }
+    }
+
+    pieces = PyArray_malloc((npieces + 1) * PIECE_SIZE * sizeof(npy_intp));
+    folds = PyArray_malloc((nfolds + 1) * PIECE_SIZE * sizeof(npy_intp));
+    if (pieces == NULL || folds == NULL) {
+        PyErr_NoMemory();
+        goto fail;
+    }
+    npieces = nfolds = nscratch = 0;
+    for (i = 0; i < m; ++i) {
+        npy_intp start = ind[i];
+        npy_intp end = (i + 1 < m) ? ind[i + 1] : n;
+        npy_intp row = i, first_scratch = nscratch;
+
+        if (end <= start) {
+            end = start + 1;
+        }
+        while (start < end) {
+            npy_intp *piece = pieces + npieces * PIECE_SIZE;
+            npy_intp len = end - start;
+
+            piece[PIECE_DST] = row;
+            piece[PIECE_START] = start;
+            piece[PIECE_END] = start + (len > piecelen ? piecelen : len);
+            start = piece[PIECE_END];
+            npieces++;
+            if (start < end) {
+                row = m + nscratch++;
+            }
+        }
+        if (nscratch > first_scratch) {
+            npy_intp *fold = folds + nfolds * PIECE_SIZE;
+            fold[PIECE_DST] = i;
+            fold[PIECE_START] = first_scratch;
+            fold[PIECE_END] = nscratch;
+            nfolds++;
+        }
+    }
+
+    /* Reduce straight into 'out' when it already has the working layout */
+    if (out != NULL && PyMicArray_IS_C_CONTIGUOUS(out) &&
+            PyArray_EquivTypes(PyMicArray_DESCR(out), dtype) &&
+            PyMicArray_DEVICE(out) == device &&
+            solve_may_share_memory(arr, out, 1) == 0) {
+        Py_INCREF(out);
+        work = out;
+    }
+    else {
+        Py_INCREF(dtype);
+        work = (PyMicArrayObject *)PyMicArray_NewFromDescr(device,
+                                    &PyMicArray_Type, dtype,
+                                    ndim, shape, NULL, NULL, 0, NULL);
+        if (work == NULL) {
+            goto fail;
+        }
+    }
+
+    /* The inner loop wants contiguous input of the reduction dtype */
+    if (PyMicArray_IS_C_CONTIGUOUS(arr) &&
+            PyArray_EquivTypes(PyMicArray_DESCR(arr), dtype)) {
+        Py_INCREF(arr);
+        input = arr;
+    }
+    else {
+        Py_INCREF(dtype);
+        input = (PyMicArrayObject *)PyMicArray_NewFromDescr(device,
+                                    &PyMicArray_Type, dtype,
+                                    ndim, PyMicArray_DIMS(arr), NULL,
+                                    NULL, 0, NULL);
+        if (input == NULL || PyMicArray_CopyInto(input, arr) < 0) {
+            goto fail;
+        }
+    }
+
+    if (nscratch > 0) {
+        npy_intp scratch_shape[3];
+
+        scratch_shape[0] = outer;
+        scratch_shape[1] = nscratch;
+        scratch_shape[2] = inner;
+        Py_INCREF(dtype);
+        scratch = (PyMicArrayObject *)PyMicArray_NewFromDescr(device,
+                                    &PyMicArray_Type, dtype,
+                                    3, scratch_shape, NULL, NULL, 0, NULL);
+        if (scratch == NULL) {
+            goto fail;
+        }
+    }
+
+    if (outer * m * inner > 0) {
+        NPY_BEGIN_THREADS_THRESHOLDED(outer * n * inner);
+        run_segments(innerloop, innerloopdata, device,
+                     PyMicArray_DATA(input), PyMicArray_DATA(work),
+                     scratch ? PyMicArray_DATA(scratch) : NULL,
+                     pieces, npieces, folds, nfolds, nscratch,
+                     outer, n, m, inner, dtype->elsize);
+        NPY_END_THREADS;
+    }
+
+    PyArray_free(pieces);
+    PyArray_free(folds);
+    Py_DECREF(input);
+    Py_XDECREF(scratch);
+
+    if (out != NULL && work != out) {
+        if (PyMicArray_CopyInto(out, work) < 0) {
+            Py_DECREF(work);
+            return NULL;
+        }
+        Py_DECREF(work);
+        Py_INCREF(out);
+        return out;
+    }
+    return work;
+
+fail:
+    PyArray_free(pieces);
+    PyArray_free(folds);
+    Py_XDECREF(work);
+    Py_XDECREF(input);
+    Py_XDECREF(scratch);
+    return NULL;
+}
@@ -0,0 +1,14 @@
+#ifndef _MPY_MUFUNC_SEGMENT_H
+#define _MPY_MUFUNC_SEGMENT_H
+
+/*
+ * ufunc.reduceat along 'axis' of 'arr' over the segments starting at
+ * 'indices' (a 1-d host intp array), computed in 'dtype' on the device
+ * of 'arr'.  'out' may be NULL.  Returns a new reference.
+ */
+NPY_NO_EXPORT PyMicArrayObject *
+mpy_segment_reduceat(PyUFuncObject *ufunc, PyMicArrayObject *arr,
+                     PyArrayObject *indices, PyMicArrayObject *out,
+                     int axis, PyArray_Descr *dtype);
+
+#endif
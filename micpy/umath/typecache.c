@@ -0,0 +1,314 @@
+/*
+ * Type resolution cache of ufunc calls.
+ *
+ * Every ufunc call runs numpy's type resolver, which walks the loop
+ * table of the ufunc and checks castings, and then the legacy inner
+ * loop selector, which walks it again.  Programs tend to repeat the
+ * same handful of dtype combinations, so the outcome is remembered in
+ * a small direct mapped table, keyed by the ufunc, the casting rule
+ * and the descr and 0-d-ness of each operand.  When 0-d and higher
+ * dimensional inputs are mixed, numpy's value based casting looks at
+ * the scalar values, so the key also holds the PyArray_MinScalarType
+ * of each 0-d input, which is all the resolver uses of its value.  The
+ * key descrs and the resolved dtypes are owned by the entry, so the
+ * descr pointers of a live entry can't be recycled.
+ *
+ * Since numpy ufuncs have no room for extra members, the entries of
+ * all ufuncs share the table, and each remembers the loop table
+ * (functions, ntypes, userloops) it was resolved against and the slot
+ * of the table its inner loop came from.  Registering loops swaps the
+ * table and PyUFunc_ReplaceLoopBySignature overwrites the slot, either
+ * invalidates the stale entries at their next lookup.  A dying ufunc
+ * drops its entries.
+ *
+ * Calls whose resolution may depend on more than the key are never
+ * cached: type_tup/sig arguments (callers don't consult the cache),
+ * and user defined or flexible dtypes, which go through the userloops.
+ */
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#define NPY_NO_DEPRECATED_API NPY_API_VERSION
+#define PY_ARRAY_UNIQUE_SYMBOL _mpy_umathmodule_ARRAY_API
+#define NO_IMPORT_ARRAY
+#define PY_UFUNC_UNIQUE_SYMBOL _mpy_umathmodule_UFUNC_API
+#define NO_IMPORT_UFUNC
+#include <numpy/npy_common.h>
+#include <numpy/arrayobject.h>
+#include <numpy/ufuncobject.h>
+#include <numpy/npy_3kcompat.h>
+
+#define PyMicArray_API_UNIQUE_NAME _mpy_umathmodule_MICARRAY_API
+#define PyMicArray_NO_IMPORT
+#include <multiarray/arrayobject.h>
+#include <multiarray/multiarray_api.h>
+#include <multiarray/mpy_common.h>
+#include <multiarray/common.h>
+
+#include "typecache.h"
+
+/* Number of entries, a power of two */
+#define MPY_TYPECACHE_SIZE 256
+
+typedef struct {
+    PyUFuncObject *ufunc;
+    /* The loop table the entry was resolved against */
+    PyUFuncGenericFunction *functions;
+    int ntypes;
+    PyObject *userloops;
+    /* Slot of the loop table that gave innerloop */
+    int index;
+    /* Key */
+    int casting;
+    npy_uint32 scalars;
+    PyArray_Descr *key[NPY_MAXARGS];
+    /* Minimum scalar types of value based casting, or NPY_NOTYPE */
+    int mintypes[NPY_MAXARGS];
+    /* Value */
+    PyArray_Descr *dtypes[NPY_MAXARGS];
+    PyUFuncGenericFunction innerloop;
+    void *innerloopdata;
+} mpy_typecache_entry;
+
+static mpy_typecache_entry typecache[MPY_TYPECACHE_SIZE];
+static npy_intp typecache_hits = 0;
+static npy_intp typecache_misses = 0;
+
+/*
+ * Type number of PyArray_MinScalarType of the 0-d array 'op', whose
+ * value is read from a host copy.
+ */
+static int
+_min_scalar_type(PyMicArrayObject *op)
+{
+    npy_longlong buf[4];
+    PyArray_Descr *dtype;
+    char *data = op->data;
+    int type_num;
+
+    target_memcpy(buf, data, PyMicArray_ITEMSIZE(op),
+                  CPU_DEVICE, PyMicArray_DEVICE(op));
+    /* Same work around as for numpy's type resolver */
+    op->data = (char *)buf;
+    dtype = PyArray_MinScalarType((PyArrayObject *)op);
+    op->data = data;
+
+    type_num = dtype->type_num;
+    Py_DECREF(dtype);
+    return type_num;
+}
+
+/*
+ * Fills the key of a call in 'key', 'scalars' and 'mintypes' and returns
+ * its slot, or -1 if the call can't be cached.
+ */
+static int
+_make_key(PyUFuncObject *ufunc, NPY_CASTING casting, PyMicArrayObject **op,
+          PyArray_Descr **key, npy_uint32 *scalars, int *mintypes)
+{
+    int i, nop = ufunc->nin + ufunc->nout, nscalars = 0;
+    npy_uintp hash = ((npy_uintp)ufunc >> 4) ^ (npy_uintp)casting;
+
+    *scalars = 0;
+    for (i = 0; i < nop; ++i) {
+        mintypes[i] = NPY_NOTYPE;
+        if (op[i] == NULL) {
+            key[i] = NULL;
+        }
+        else {
+            int type_num = PyMicArray_TYPE(op[i]);
+
+            if (PyTypeNum_ISUSERDEF(type_num) ||
+                    PyTypeNum_ISFLEXIBLE(type_num)) {
+                return -1;
+            }
+            key[i] = PyMicArray_DESCR(op[i]);
+            if (i < ufunc->nin && PyMicArray_NDIM(op[i]) == 0) {
+                *scalars |= (npy_uint32)1 << i;
+                nscalars++;
+            }
+        }
+        hash = hash * 31 + ((npy_uintp)key[i] >> 4);
+    }
+
+    /* Value based casting, the scalar values matter */
+    if (nscalars != 0 && nscalars != ufunc->nin) {
+        for (i = 0; i < ufunc->nin; ++i) {
+            if (*scalars & ((npy_uint32)1 << i)) {
+                mintypes[i] = _min_scalar_type(op[i]);
+                hash = hash * 31 + (npy_uintp)mintypes[i];
+            }
+        }
+    }
+
+    hash ^= hash >> 13;
+    return (int)((hash ^ *scalars) & (MPY_TYPECACHE_SIZE - 1));
+}
+
+static void
+_clear_entry(mpy_typecache_entry *entry, int nop)
+{
+    int i;
+
+    for (i = 0; i < nop; ++i) {
+        Py_XDECREF(entry->key[i]);
+        Py_XDECREF(entry->dtypes[i]);
+        entry->key[i] = NULL;
+        entry->dtypes[i] = NULL;
+    }
+    entry->ufunc = NULL;
+}
+
+/*
+ * Returns the slot of the loop table the legacy selector picks for
+ * 'dtypes', the first one matching all type numbers, or -1 if it didn't
+ * give innerloop, e.g. because a custom selector is installed.
+ */
+static int
+_loop_index(PyUFuncObject *ufunc, PyArray_Descr **dtypes,
+            PyUFuncGenericFunction innerloop, void *innerloopdata)
+{
+    int i, j, nop = ufunc->nin + ufunc->nout;
+
+    for (i = 0; i < ufunc->ntypes; ++i) {
+        const char *types = ufunc->types + i * nop;
+
+        for (j = 0; j < nop; ++j) {
+            if (types[j] != dtypes[j]->type_num) {
+                break;
+            }
+        }
+        if (j == nop) {
+            return (ufunc->functions[i] == innerloop &&
+                    ufunc->data[i] == innerloopdata) ? i : -1;
+        }
+    }
+    return -1;
+}
+
+NPY_NO_EXPORT int
+mpy_typecache_lookup(PyUFuncObject *ufunc, NPY_CASTING casting,
+                     PyMicArrayObject **op, PyArray_Descr **out_dtypes,
+                     PyUFuncGenericFunction *out_innerloop,
+                     void **out_innerloopdata)
+{
+    PyArray_Descr *key[NPY_MAXARGS];
+    mpy_typecache_entry *entry;
+    npy_uint32 scalars;
+    int mintypes[NPY_MAXARGS];
+    int i, nop = ufunc->nin + ufunc->nout;
+    int slot = _make_key(ufunc, casting, op, key, &scalars, mintypes);
+
+    if (slot < 0) {
+        return 0;
+    }
+
+    entry = &typecache[slot];
+    if (entry->ufunc != ufunc || entry->casting != (int)casting ||
+            entry->scalars != scalars ||
+            memcmp(entry->key, key, nop * sizeof(PyArray_Descr *)) != 0 ||
+            memcmp(entry->mintypes, mintypes, nop * sizeof(int)) != 0) {
+        typecache_misses++;
+        return 0;
+    }
+    if (entry->functions != ufunc->functions ||
+            entry->ntypes != ufunc->ntypes ||
+            entry->userloops != ufunc->userloops ||
+            ufunc->functions[entry->index] != entry->innerloop ||
+            ufunc->data[entry->index] != entry->innerloopdata) {
+        /* Loops were registered or replaced since */
+        _clear_entry(entry, nop);
+        typecache_misses++;
+        return 0;
+    }
+
+    for (i = 0; i < nop; ++i) {
+        Py_INCREF(entry->dtypes[i]);
+        out_dtypes[i] = entry->dtypes[i];
+    }
+    *out_innerloop = entry->innerloop;
+    *out_innerloopdata = entry->innerloopdata;
+    typecache_hits++;
+    return 1;
+}
+
+NPY_NO_EXPORT void
+mpy_typecache_store(PyUFuncObject *ufunc, NPY_CASTING casting,
+                    PyMicArrayObject **op, PyArray_Descr **dtypes,
+                    PyUFuncGenericFunction innerloop, void *innerloopdata)
+{
+    PyArray_Descr *key[NPY_MAXARGS];
+    mpy_typecache_entry *entry;
+    npy_uint32 scalars;
+    int mintypes[NPY_MAXARGS];
+    int i, nop = ufunc->nin + ufunc->nout;
+    int slot = _make_key(ufunc, casting, op, key, &scalars, mintypes);
+    int index = _loop_index(ufunc, dtypes, innerloop, innerloopdata);
+
+    if (slot < 0 || index < 0) {
+        return;
+    }
+
+    entry = &typecache[slot];
+    if (entry->ufunc != NULL) {
+        _clear_entry(entry, entry->ufunc->nin + entry->ufunc->nout);
+    }
+    entry->ufunc = ufunc;
+    entry->functions = ufunc->functions;
+    entry->ntypes = ufunc->ntypes;
+    entry->userloops = ufunc->userloops;
+    entry->index = index;
+    entry->casting = (int)casting;
+    entry->scalars = scalars;
+    for (i = 0; i < nop; ++i) {
+        Py_XINCREF(key[i]);
+        Py_INCREF(dtypes[i]);
+        entry->key[i] = key[i];
+        entry->mintypes[i] = mintypes[i];
+        entry->dtypes[i] = dtypes[i];
+    }
+    entry->innerloop = innerloop;
+    entry->innerloopdata = innerloopdata;
+}
+
+NPY_NO_EXPORT void
+mpy_typecache_invalidate(PyUFuncObject *ufunc)
+{
+    int i;
+
+    for (i = 0; i < MPY_TYPECACHE_SIZE; ++i) {
+        mpy_typecache_entry *entry = &typecache[i];
+
+        if (entry->ufunc != NULL &&
+                (ufunc == NULL || entry->ufunc == ufunc)) {
+            _clear_entry(entry, entry->ufunc->nin + entry->ufunc->nout);
+        }
+    }
+}
+
+NPY_NO_EXPORT PyObject *
+mpy_typecache_get_info(PyObject *NPY_UNUSED(self),
+                       PyObject *NPY_UNUSED(args))
+{
+    npy_intp i, entries = 0, calls = typecache_hits + typecache_misses;
+
+    for (i = 0; i < MPY_TYPECACHE_SIZE; ++i) {
+        entries += (typecache[i].ufunc != NULL);
+    }
+    return Py_BuildValue("{s:n,s:n,s:d,s:n,s:i}",
+                         "hits", typecache_hits,
+                         "misses", typecache_misses,
+                         "hit_rate", calls ? (double)typecache_hits / calls
+                                           : 0.0,
+                         "entries", entries,
+                         "size", MPY_TYPECACHE_SIZE);
+}
+
+NPY_NO_EXPORT PyObject *
+mpy_typecache_clear(PyObject *NPY_UNUSED(self), PyObject *NPY_UNUSED(args))
+{
+    mpy_typecache_invalidate(NULL);
+    typecache_hits = 0;
+    typecache_misses = 0;
+    Py_RETURN_NONE;
+}
@@ -0,0 +1,37 @@
+#ifndef _MPY_MUFUNC_TYPECACHE_H
+#define _MPY_MUFUNC_TYPECACHE_H
+
+/*
+ * Cache of the type resolution and legacy inner loop selection of
+ * ufunc calls, keyed by the ufunc, the casting rule and the dtype and
+ * 0-d-ness of every operand (NULL outputs included), plus the minimum
+ * scalar type of 0-d inputs mixed with arrays.
+ *
+ * mpy_typecache_lookup returns 1 and fills 'out_dtypes' with new
+ * references on a hit, 0 on a miss.  mpy_typecache_store records a
+ * successful resolution; calls the cache can't describe are ignored by
+ * both.
+ */
+NPY_NO_EXPORT int
+mpy_typecache_lookup(PyUFuncObject *ufunc, NPY_CASTING casting,
+                     PyMicArrayObject **op, PyArray_Descr **out_dtypes,
+                     PyUFuncGenericFunction *out_innerloop,
+                     void **out_innerloopdata);
+
+NPY_NO_EXPORT void
+mpy_typecache_store(PyUFuncObject *ufunc, NPY_CASTING casting,
+                    PyMicArrayObject **op, PyArray_Descr **dtypes,
+                    PyUFuncGenericFunction innerloop, void *innerloopdata);
+
+/* Drops the entries of 'ufunc', or all entries if it is NULL */
+NPY_NO_EXPORT void
+mpy_typecache_invalidate(PyUFuncObject *ufunc);
+
+NPY_NO_EXPORT PyObject *
+mpy_typecache_get_info(PyObject *NPY_UNUSED(self),
+                       PyObject *NPY_UNUSED(args));
+
+NPY_NO_EXPORT PyObject *
+mpy_typecache_clear(PyObject *NPY_UNUSED(self), PyObject *NPY_UNUSED(args));
+
+#endif
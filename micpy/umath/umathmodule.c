@@ -36,6 +36,10 @@
 
 #define _MICARRAY_UMATHMODULE
 #include "mufunc_object.h"
+#include "dispatch.h"
+#include "lazy.h"
+#include "elementwise.h"
+#include "typecache.h"
 //#include "reducion.h"
 
 /*
@@ -136,11 +140,128 @@ intern_strings(void)
     return mpy_um_str_out && mpy_um_str_subok && mpy_um_str_array_wrap;
 }
 
+/*
+ *****************************************************************************
+ **                            SIMD INSTRUCTION SET                         **
+ *****************************************************************************
+ */
+
+/* Indexed by MPY_SIMD_NONE ... MPY_SIMD_AVX512F */
+static const char *simd_isa_names[] = {"none", "avx2", "avx512f"};
+
+static PyObject *
+umath_get_simd_isa(PyObject *NPY_UNUSED(self), PyObject *NPY_UNUSED(args))
+{
+    return Py_BuildValue("{s:s,s:s}",
+                         "isa", simd_isa_names[mpy_simd_get_isa()],
+                         "native", simd_isa_names[mpy_simd_native_isa()]);
+}
+
+static PyObject *
+umath_set_simd_isa(PyObject *NPY_UNUSED(self), PyObject *args)
+{
+    const char *name;
+    int level;
+
+    if (!PyArg_ParseTuple(args, "s", &name)) {
+        return NULL;
+    }
+    for (level = MPY_SIMD_NONE; level <= MPY_SIMD_AVX512F; ++level) {
+        if (strcmp(name, simd_isa_names[level]) == 0) {
+            break;
+        }
+    }
+    if (level > MPY_SIMD_AVX512F) {
+        PyErr_Format(PyExc_ValueError,
+                     "unknown instruction set '%s'", name);
+        return NULL;
+    }
+    if (mpy_simd_set_isa(level) < 0) {
+        PyErr_Format(PyExc_ValueError,
+                     "instruction set '%s' is not supported here", name);
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+/* Indexed by MPY_PRECISION_ACCURATE, MPY_PRECISION_FAST */
+static const char *precision_names[] = {"accurate", "fast"};
+
+static PyObject *
+umath_get_precision(PyObject *NPY_UNUSED(self), PyObject *NPY_UNUSED(args))
+{
+    return PyUString_FromString(precision_names[mpy_simd_get_precision()]);
+}
+
+static PyObject *
+umath_set_precision(PyObject *NPY_UNUSED(self), PyObject *args)
+{
+    const char *name;
+
+    if (!PyArg_ParseTuple(args, "s", &name)) {
+        return NULL;
+    }
+    if (strcmp(name, precision_names[MPY_PRECISION_FAST]) == 0) {
+        mpy_simd_set_precision(MPY_PRECISION_FAST);
+    }
+    else if (strcmp(name, precision_names[MPY_PRECISION_ACCURATE]) == 0) {
+        mpy_simd_set_precision(MPY_PRECISION_ACCURATE);
+    }
+    else {
+        PyErr_Format(PyExc_ValueError,
+                     "precision must be 'accurate' or 'fast', not '%s'", name);
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
 /* Setup the umath module */
 /* Remove for time being, it is declared in __ufunc_api.h */
 /*static PyTypeObject PyUFunc_Type;*/
 
 static struct PyMethodDef methods[] = {
+    {"_get_dispatch_config",
+        (PyCFunction)mpy_dispatch_get_config,
+        METH_NOARGS, NULL},
+    {"_set_dispatch_config",
+        (PyCFunction)mpy_dispatch_set_config,
+        METH_VARARGS | METH_KEYWORDS, NULL},
+    {"_calibrate_dispatch",
+        (PyCFunction)mpy_dispatch_calibrate,
+        METH_VARARGS | METH_KEYWORDS, NULL},
+    {"_set_lazy_hook",
+        (PyCFunction)mpy_lazy_set_hook,
+        METH_VARARGS, NULL},
+    {"_set_lazy",
+        (PyCFunction)mpy_lazy_set_enabled,
+        METH_VARARGS, NULL},
+    {"_set_lazy_write_hook",
+        (PyCFunction)mpy_lazy_set_write_hook,
+        METH_VARARGS, NULL},
+    {"_lazy_execute",
+        (PyCFunction)mpy_lazy_execute,
+        METH_VARARGS, NULL},
+    {"_ufunc_from_kernel",
+        (PyCFunction)mpy_ufunc_from_kernel,
+        METH_VARARGS, NULL},
+    {"_get_typecache_info",
+        (PyCFunction)mpy_typecache_get_info,
+        METH_NOARGS, NULL},
+    {"_clear_typecache",
+        (PyCFunction)mpy_typecache_clear,
+        METH_NOARGS, NULL},
+    {"_get_simd_isa",
+        (PyCFunction)umath_get_simd_isa,
+        METH_NOARGS, NULL},
+    {"_set_simd_isa",
+        (PyCFunction)umath_set_simd_isa,
+        METH_VARARGS, NULL},
+    {"_get_precision",
+        (PyCFunction)umath_get_precision,
+        METH_NOARGS, NULL},
+    {"_set_precision",
+        (PyCFunction)umath_set_precision,
+        METH_VARARGS, NULL},
     {NULL, NULL, 0, NULL}                /* sentinel */
 };
 
@@ -207,6 +328,9 @@ PyMODINIT_FUNC initumath(void)
     /* Import micarray */
     import_micarray();
 
+    /* Pick the instruction set of the host loops */
+    mpy_simd_get_isa();
+
     /* Initialize the types */
     if (PyType_Ready(&PyMUFunc_Type) < 0)
         return RETVAL;
@@ -35,7 +35,8 @@ private_npy_defines = [('HAVE_ENDIAN_H', 1),
             ('HAVE_COMPLEX_H', 1),
             ('HAVE_LDOUBLE_INTEL_EXTENDED_16_BYTES_LE', 1)]
 
-mpy_defines = [('MPY_HAVE_IMCI_INTRINSICS', 1)]
+mpy_defines = [('MPY_HAVE_IMCI_INTRINSICS', 1),
+               ('MPY_HAVE_AVX_INTRINSICS', 1)]
 
 
 def add_multiarray_ext(config):
@@ -46,7 +47,8 @@ def add_multiarray_ext(config):
             'convert_datatype.c', 'dtype_transfer.c', 'mpymem_overlap.c',
             'nditer_templ.c.src', 'nditer_constr.c', 'nditer_api.c',
             'arraytypes.c.src', 'mpy_lowlevel_strided_loops.c.src',
-            'temp_elide.c' ,'multiarraymodule.c']
+            'temp_elide.c', 'mempool.c', 'stream.c', 'mpy_dlpack.c',
+            'multiarraymodule.c']
     multiarray_sources = [join(multiarray_dir, f) for f in multiarray_sources]
 
     #Add numpy/private/mem_overlap.c to sources
@@ -92,9 +94,11 @@ def add_umath_ext(config):
     umath_dir = join('micpy', 'umath')
 
     umath_sources = ['umathmodule.c', 'mufunc_object.c',
-                     'output_creators.c', 'reduction.c',
+                     'output_creators.c', 'reduction.c', 'dispatch.c',
+                     'lazy.c', 'elementwise.c', 'scan.c', 'segment.c',
+                     'outer.c', 'gufunc.c', 'typecache.c',
                      'funcs.inc.src', 'loops.h.src', 'loops.c.src',
-                     'simd.inc.src']
+                     'simd.inc.src', 'scatter.c.src']
     umath_sources = [join(umath_dir, f) for f in umath_sources]
     umath_sources.append(join(mpymath_dir, 'non_standards.h.src'))
     umath_sources.append(join(multiarray_dir, 'mpymem_overlap.c'))
@@ -121,6 +125,9 @@ def configuration(parent_package='', top_path=None):
 
     config.add_subpackage('random',
                           subpackage_path=join('micpy', 'random'))
+    # Also used at run time, to compile ElementwiseKernel the same way
+    config.add_subpackage('distutils',
+                          subpackage_path=join('micpy', 'distutils'))
 
     return config
 